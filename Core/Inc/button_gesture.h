@@ -0,0 +1,78 @@
+/*
+ * button_gesture.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef INC_BUTTON_GESTURE_H_
+#define INC_BUTTON_GESTURE_H_
+
+#include <stdint.h>
+#include "debounced_button.h"
+
+//Default timings, see ButtonGestureTimings.
+#ifndef BUTTON_GESTURE_DOUBLE_CLICK_MS
+#define BUTTON_GESTURE_DOUBLE_CLICK_MS		300
+#endif
+#ifndef BUTTON_GESTURE_LONG_PRESS_MS
+#define BUTTON_GESTURE_LONG_PRESS_MS		800
+#endif
+#ifndef BUTTON_GESTURE_REPEAT_PERIOD_MS
+#define BUTTON_GESTURE_REPEAT_PERIOD_MS		150
+#endif
+
+typedef enum ButtonGestureType
+{
+	BUTTON_GESTURE_CLICK = 0, //Released before the long press, and not pressed again within the double click time
+	BUTTON_GESTURE_DOUBLE_CLICK, //Pressed again within the double click time after a click, reported on release
+	BUTTON_GESTURE_LONG_PRESS, //Once, while the button is still held
+	BUTTON_GESTURE_REPEAT, //Periodically after the long press, until the button is released
+} ButtonGestureType;
+
+typedef struct ButtonGesture
+{
+	uint16_t gpioPin;
+	ButtonGestureType type;
+	uint32_t tick; //HAL_GetTick() when the gesture was recognized
+} ButtonGesture;
+
+/*
+  The timings of a button, in milliseconds. Can be shared by buttons.
+  doubleClickMs: How long after a release a second press makes a double click. The click is only reported once
+  that time has passed. 0 disables double clicks, clicks are then reported on release.
+  longPressMs: How long a press lasts before it is a long press instead of a click. 0 disables long presses.
+  repeatPeriodMs: Period of the repeats while a long press is held. 0 disables repeats.
+*/
+typedef struct ButtonGestureTimings
+{
+	uint16_t doubleClickMs;
+	uint16_t longPressMs;
+	uint16_t repeatPeriodMs;
+} ButtonGestureTimings;
+
+//A button of the recognizer. Kept by the caller, usually in a static table initialized with GESTURE_BUTTON().
+typedef struct GestureButton
+{
+	uint16_t gpioPin;
+	const ButtonGestureTimings* timings;
+
+	//These are handled internally by PopButtonGesture().
+	uint8_t state;
+	uint8_t timerArmed;
+	uint16_t timerDuration;
+	uint32_t timerStart;
+} GestureButton;
+
+#define GESTURE_BUTTON(pin, timingsPtr)		{ (pin), (timingsPtr), 0, 0, 0, 0 }
+
+/*
+  Recognizes the gestures of the given buttons from the button events and returns the next one. Returns 1 if
+  there was one, 0 if there is nothing to report yet. Call this until it returns 0 on every pass of the main loop,
+  the timeouts are checked in the calls as well. Events of pins that are not in buttons are dropped.
+*/
+uint8_t PopButtonGesture(GestureButton* buttons, uint8_t buttonCount, ButtonGesture* gesture);
+
+//Milliseconds until the first armed timer of the buttons expires, 0 if one already did, UINT32_MAX if none is armed.
+uint32_t GetButtonGestureIdleMs(const GestureButton* buttons, uint8_t buttonCount);
+
+#endif /* INC_BUTTON_GESTURE_H_ */
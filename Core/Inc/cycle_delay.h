@@ -0,0 +1,65 @@
+/*
+ * cycle_delay.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef INC_CYCLE_DELAY_H_
+#define INC_CYCLE_DELAY_H_
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+/*
+  The clock profile the compile-time delays are computed for. This is the fastest HCLK the firmware runs at,
+  it needs to match SystemClock_Config(). Running slower only makes the delays longer, running faster would
+  make them too short, which Delay_Init() refuses.
+*/
+#ifndef DELAY_CPU_CLOCK_HZ
+#define DELAY_CPU_CLOCK_HZ				8000000
+#endif
+
+/*
+  How much faster than nominal the clock might actually be, in parts per million. Every delay is lengthened by
+  this much so it is still long enough on a fast clock. The default is the worst case HSI error of the
+  STM32F103 over temperature. Replace it with a measured value when running from a crystal or a trimmed HSI.
+*/
+#ifndef DELAY_CLOCK_ERROR_PPM
+#define DELAY_CLOCK_ERROR_PPM			25000
+#endif
+
+//The profile clock with the error margin added on top.
+#define DELAY_CPU_CLOCK_WITH_MARGIN_HZ	((uint64_t)DELAY_CPU_CLOCK_HZ * (1000000 + DELAY_CLOCK_ERROR_PPM) / 1000000)
+
+//Number of cycles lasting at least ns nanoseconds on the profile clock. Rounds up.
+#define DELAY_NS_TO_CYCLES(ns)			((uint32_t)(((uint64_t)(ns) * DELAY_CPU_CLOCK_WITH_MARGIN_HZ + 999999999) / 1000000000))
+
+//Number of cycles lasting at least us microseconds on the profile clock.
+#define DELAY_US_TO_CYCLES(us)			DELAY_NS_TO_CYCLES((uint64_t)(us) * 1000)
+
+/*
+  Enables the DWT cycle counter and calibrates the run-time conversions below for the current HCLK. Call this
+  after the clock is configured, and again whenever it changes. Returns 0 if HCLK is faster than
+  DELAY_CPU_CLOCK_HZ, in which case the compile-time delays are too short. Returns 1 otherwise.
+*/
+uint8_t Delay_Init(void);
+
+//Converts microseconds into cycles of the current HCLK, including the clock error margin. Rounds up.
+uint32_t Delay_MicrosecondsToCycles(uint32_t us);
+
+//Waits until at least cycles CPU cycles have passed since the DWT cycle count start was taken.
+static inline void Delay_CyclesFrom(uint32_t start, uint32_t cycles)
+{
+	while ((DWT->CYCCNT - start) < cycles) { }
+}
+
+//Waits for at least the given number of CPU cycles. Overshoots by at most one iteration of the loop.
+static inline void Delay_Cycles(uint32_t cycles)
+{
+	Delay_CyclesFrom(DWT->CYCCNT, cycles);
+}
+
+//Waits for at least the given number of microseconds of the current HCLK.
+void Delay_Microseconds(uint32_t us);
+
+#endif /* INC_CYCLE_DELAY_H_ */
@@ -22,24 +22,113 @@ typedef enum ButtonState
 	BUTTON_STATE_HELD,
 } ButtonState;
 
+/*
+  Debounces up to 16 pins of one port together. Every sample is a single read of the input data register, and a
+  vertical counter (one 2-bit counter per pin, kept as two bit planes) counts how many samples in a row each pin
+  differed from its debounced state. A pin changes state after BUTTON_BANK_STABLE_SAMPLES such samples, so its
+  event is queued at most BUTTON_BANK_STABLE_SAMPLES * BUTTON_BANK_SAMPLE_PERIOD_MS (20ms) after the contacts stop
+  bouncing, see Tests/test_button_latency.c.
+*/
+#define BUTTON_BANK_STABLE_SAMPLES			4 //Fixed by the width of the counter
+#define BUTTON_BANK_SAMPLE_PERIOD_MS		(DEBOUNCED_BUTTON_DEFAULT_DEBOUNCE_TIME_MS / BUTTON_BANK_STABLE_SAMPLES)
+
+typedef struct ButtonBank
+{
+	GPIO_TypeDef* port;
+	uint16_t pins; //Pins that are sampled
+	uint16_t pressedWhenLow; //Pins that read 0 when pressed
+
+	//These are handled internally by the functions below, one bit per pin.
+	uint16_t state; //Debounced state, 1 is pressed
+	uint16_t counterLow; //Bit planes of the vertical counter
+	uint16_t counterHigh;
+	uint16_t pressedEdges; //Pins that got pressed/released since the edges were last taken
+	uint16_t releasedEdges;
+	uint32_t lastSampleTick;
+} ButtonBank;
+
+//Adds a pin of the given port to the bank. All the pins of a bank are on the same port.
+void ButtonBank_AddPin(ButtonBank* bank, GPIO_TypeDef* port, uint16_t pin, GPIO_PinState expectedSignalWhenPressed);
+
+//Runs the integrator of every pin with a sample of the input data register.
+void ButtonBank_Sample(ButtonBank* bank, uint16_t inputData);
+
+//Samples the port if BUTTON_BANK_SAMPLE_PERIOD_MS passed since the last sample. Call this as often as possible.
+void ButtonBank_Update(ButtonBank* bank);
+
+//Returns the pins that got pressed since the last call and forgets them.
+uint16_t ButtonBank_TakePressed(ButtonBank* bank, uint16_t pins);
+
+//Returns the pins that got released since the last call and forgets them.
+uint16_t ButtonBank_TakeReleased(ButtonBank* bank, uint16_t pins);
+
+//Returns the pins that are currently held down.
+static inline uint16_t ButtonBank_GetHeld(const ButtonBank* bank)
+{
+	return bank->state;
+}
+
+//A single button, a view over its pin in the bank of the buttons.
 typedef struct DebouncedButton
 {
-	//These are safe to modify
-	uint32_t debounceTime;
-	GPIO_TypeDef* gpioChannel;
+	ButtonBank* bank;
 	uint16_t gpioPin;
-	GPIO_PinState expectedSignalWhenPressed;
-
-	//These are handled internally by the functions below.
-	//Don't modify unless you know what you are doing.
-	uint32_t lastPressedTime;
-	GPIO_PinState lastPressState;
-	uint32_t lastMeasurementTime;
 } DebouncedButton;
 
-//Initializes a button with default values.
+//Initializes a button with default values. Adds the pin to the bank that SampleDebouncedButtonsFromISR() samples.
 DebouncedButton InitButtonWithDefaults(GPIO_TypeDef* gpioChannel,	uint16_t gpioPin, GPIO_PinState expectedSignalWhenPressed);
 
+#define BUTTON_EVENT_QUEUE_LENGTH			16 //Power of 2
+
+typedef enum ButtonEventType
+{
+	BUTTON_EVENT_PRESSED = 0,
+	BUTTON_EVENT_RELEASED,
+} ButtonEventType;
+
+typedef struct ButtonEvent
+{
+	uint16_t gpioPin;
+	ButtonEventType type;
+	uint32_t tick; //HAL_GetTick() when the debounced state changed
+} ButtonEvent;
+
+typedef struct ButtonEventStats
+{
+	uint32_t events;
+	uint32_t droppedEvents; //The queue was full
+	uint32_t lastQueueLatencyMs; //From the debounced state change to PopButtonEvent()
+	uint32_t maxQueueLatencyMs;
+} ButtonEventStats;
+
+/*
+  Call this from the 1ms SysTick interrupt. Samples the buttons initialized with InitButtonWithDefaults() every
+  BUTTON_BANK_SAMPLE_PERIOD_MS and queues an event for every change of their debounced states, so presses are
+  neither delayed nor lost while the main loop is busy or asleep. Sampling stops once every button has settled,
+  until SignalButtonEdgeFromISR() starts it again.
+*/
+void SampleDebouncedButtonsFromISR(void);
+
+/*
+  Call this from the EXTI interrupt of the rising and falling edges of a button pin. Starts sampling the buttons
+  until they settle. The EXTI interrupts need the priority of SysTick, so that neither preempts the other.
+*/
+void SignalButtonEdgeFromISR(uint16_t gpioPin);
+
+//Takes the oldest event out of the queue. Returns 1 if there was one, 0 if the queue is empty.
+uint8_t PopButtonEvent(ButtonEvent* event);
+
+//Returns 1 if there are events in the queue.
+uint8_t HasButtonEvents(void);
+
+//Returns how many press events were queued so far. A different value later on means a new press came in between,
+//whether or not the events were taken out of the queue since.
+uint32_t GetButtonPressCount(void);
+
+//Returns the counters of the event queue.
+const ButtonEventStats* GetButtonEventStats(void);
+
 //Returns if the button is not pressed, was just pressed or is currently held down.
+//The press is returned once, afterwards the button is held until it is released.
 ButtonState GetDebouncedButtonState(DebouncedButton* button);
 #endif /* INC_DEBOUNCED_BUTTON_H_ */
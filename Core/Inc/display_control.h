@@ -9,6 +9,7 @@
 #define INC_DISPLAY_CONTROL_H_
 
 #include <stdint.h>
+#include "lcd_HD44780U.h"
 
 #define TEMP_UNIT_CELSIUS 0
 #define TEMP_UNIT_FAHRENHEIT 1
@@ -20,6 +21,25 @@
 #define DISPLAY_FORMAT_12H 1
 #define DISPLAY_FORMAT_24H 0
 
+//Panels of at least 20x4 show the time, date, alarm and temperature together on the first page.
+#define DISPLAY_USE_OVERVIEW_PAGE (LCD_ROWS >= 4 && LCD_COLUMNS >= 20)
+
+#define DISPLAY_PAGE_TIME 1
+#if DISPLAY_USE_OVERVIEW_PAGE
+#define DISPLAY_PAGE_ALARM DISPLAY_PAGE_TIME //Part of the overview
+#else
+#define DISPLAY_PAGE_ALARM 2 //Alarm and temperature
+#endif
+#define DISPLAY_PAGE_BIG_CLOCK (DISPLAY_PAGE_ALARM + 1) //HH:MM in two line tall digits
+#define DISPLAY_PAGE_DIAGNOSTICS (DISPLAY_PAGE_ALARM + 2) //Load of the main loop, editor and commit stats
+#define DISPLAY_PAGE_DATE (DISPLAY_PAGE_ALARM + 3) //Full date, scrolled through the second line
+#define DISPLAY_PAGE_COUNT DISPLAY_PAGE_DATE
+
+//How late an expected second boundary can be before the SQW signal counts as missing and the time is polled, and
+//how late a pre-rendered frame can still be flipped in.
+#define DISPLAY_SQW_TOLERANCE_MS 20
+#define DISPLAY_FLIP_MAX_LATENCY_MS 50
+
 #define DISPLAY_TOGGLE_COOLDOWN_TIME_MS  500 //in milliseconds
 
 #define DISPLAY_TOGGLE_REJECTED 0
@@ -28,22 +48,19 @@
 typedef struct DisplayInfo
 {
 	//DISPLAY PAGE 1 INFO
-	uint8_t hours; //01-12 or 00-23
+	uint8_t hours; //00-23, converted to the display format only when rendering
 	uint8_t minutes; //00-59
 	uint8_t seconds; //00-59
-	uint8_t displayFormat; //12h (0) or 24h (1)
+	uint8_t displayFormat; //DISPLAY_FORMAT_12H or DISPLAY_FORMAT_24H, a setting of the clock, not read from DS3231
 	uint8_t dayOfTheMonth; //01-31
 	uint8_t month; //01-12
 	uint16_t year; //00-99 (century information is handled separately)
 	uint8_t dayOfTheWeek; //01-07
-	uint8_t isTimePM; //1 means PM, 0 means AM. Only used when 12 hour format is active.
 
 	//DISPLAY PAGE 2 INFO
-	uint8_t alarmHours; //01-12 or 00-23
+	uint8_t alarmHours; //00-23, displayed in displayFormat
 	uint8_t alarmMinutes; //00-59
 	uint8_t alarmEnabled; //0 for disabled, 1 for enabled
-	uint8_t isAlarmTimePM; //1 for PM, 0 for AM
-	uint8_t alarmDisplayFormat; //12h (0) or 24h (1)
 
 	//Represented as fixed-point decimal number. Upper 8 bits are the integer part.
 	//Upper 2 bits of the lower 8 bits are the fractional part. Other 6 bits are unused.
@@ -54,19 +71,70 @@ typedef struct DisplayInfo
 	uint8_t tempUnit; //celsius (0), fahrenheit (1) or kelvin (2)
 } DisplayInfo;
 
+//Parts of DisplayInfo that pages are rendered from, see GetChangedDisplayFields().
+#define DISPLAY_FIELD_SECONDS (1 << 0)
+#define DISPLAY_FIELD_MINUTES (1 << 1)
+#define DISPLAY_FIELD_HOURS (1 << 2)
+#define DISPLAY_FIELD_DATE (1 << 3) //Day of the month, month and year
+#define DISPLAY_FIELD_WEEKDAY (1 << 4)
+#define DISPLAY_FIELD_ALARM (1 << 5) //Alarm time and whether it is enabled
+#define DISPLAY_FIELD_TEMPERATURE (1 << 6)
+#define DISPLAY_FIELD_FORMAT (1 << 7) //12h/24h and the temperature unit
+#define DISPLAY_FIELD_ALL 0xFF
+
+//Groups of DS3231 registers that DisplayInfo is filled from, see GetDisplaySources().
+#define DISPLAY_SOURCE_TIME (1 << 0) //Seconds, minutes and hours
+#define DISPLAY_SOURCE_DATE (1 << 1) //Day of the week, day of the month, month, year and the century bit
+#define DISPLAY_SOURCE_ALARM (1 << 2) //Alarm time and whether it is enabled
+#define DISPLAY_SOURCE_TEMPERATURE (1 << 3)
+#define DISPLAY_SOURCE_ALL 0x0F
+
+typedef struct DisplayFlipStats
+{
+	uint32_t flips; //Pre-rendered frames flipped in at a second boundary
+	uint32_t discardedFrames; //Pre-rendered frames that turned out to be wrong or too late
+	uint32_t lastJitterCycles; //CPU cycles between the SQW edge and the flip
+	uint32_t maxJitterCycles;
+} DisplayFlipStats;
+
+typedef struct DisplayRenderStats
+{
+	uint32_t renders;
+	uint32_t lastRenderCycles; //Clearing and formatting the page into the framebuffer, without the LCD writes
+	uint32_t maxRenderCycles;
+	uint32_t lastRenderedCharacters; //Characters formatted by the last render, only the changed fields on some pages
+} DisplayRenderStats;
+
+//Measurements of the main loop and the editor shown on the diagnostics page, see SetDisplayDiagnostics().
+typedef struct DisplayDiagnostics
+{
+	uint32_t cpuLoadHundredths; //Load of the main loop in hundredths of a percent
+	uint32_t lastEditCycles; //EditorStats.lastIncrementCycles
+	uint32_t lastEditCharacters; //EditorStats.lastIncrementCharacters
+	uint8_t lastCommitTransactions; //I2C transactions the last commit of the edited values took
+} DisplayDiagnostics;
+
 /*
-  This function clears whatever was on the LCD display previously, unless info == NULL.
+  Renders the current page with the given info if it changed or if the refresh period of the page has passed.
+  Only the characters that are different from what is on the screen are written. Does nothing if info == NULL.
 */
 void DisplayTime(DisplayInfo* info);
 
 /*
-  1 for display page 1 (time info). 2 for display page 2 (alarm and temperature info).
-  Any other value is clamped. No change happens if page is the currently displayed page.
+  Renders info right away, for values changed in edit mode. Only the fields that differ from the screen are
+  formatted and written, the refresh period and the flips at the second boundary don't apply. Moves the cursor.
+  Returns the number of characters written.
+*/
+uint32_t DisplayEditedInfo(const DisplayInfo* info);
+
+/*
+  Switches to one of the DISPLAY_PAGE_ values and redraws the screen. Any other value is clamped.
+  No change happens if page is the currently displayed page.
 */
 void SwitchToPage(uint8_t page);
 
 /*
-  Display page 1 if currently page 2 is displayed and vice versa.
+  Displays the next page, the last page is followed by page 1.
 */
 void ToggleDisplayedPage(void);
 
@@ -74,6 +142,8 @@ void ToggleDisplayedPage(void);
   Toggles the display if enough time has passed since last toggle signal.
   Doesn't take the time passed since the other display toggle functions called into
   account.
+  The switch itself happens in the next DisplayTime() call, so that the info passed there already has what the
+  next page needs, see GetDisplaySources().
   Returns whether or not the display was toggled. (1 on toggle, 0 on not toggle)
 */
 uint8_t SignalDisplayToggle(void);
@@ -83,4 +153,56 @@ uint8_t SignalDisplayToggle(void);
 */
 uint8_t GetCurrentPage(void);
 
+/*
+  Returns the DISPLAY_SOURCE_ bits of the info the next DisplayTime() call renders from. These are the sources of
+  the current page, and of the requested page while a toggle is pending. The other parts of the info don't need
+  to be read, they are not displayed.
+*/
+uint8_t GetDisplaySources(void);
+
+/*
+  Call this from the interrupt of the SQW falling edge, which is when the DS3231 moves to the next second.
+  The next FlipToNextSecond() or DisplayTime() call then flips in the frame rendered for that second beforehand.
+*/
+void SignalSecondBoundary(void);
+
+/*
+  Flips in the frame rendered beforehand for the second that just started, if there was a boundary since the last
+  call. info is what was passed to DisplayTime() last, the frame is only used if nothing but the time changed since.
+  Call this right after waking up for the boundary, before reading the DS3231, so that the read doesn't delay the
+  flip. Returns 1 if the frame was flipped in. Does nothing without double buffering.
+*/
+uint8_t FlipToNextSecond(const DisplayInfo* info);
+
+/*
+  Returns 1 if the info passed to DisplayTime() has to be read again: nothing was displayed yet, a page toggle is
+  pending or the DS3231 moved to the next second. Each second boundary is returned once. Without the SQW signal
+  the boundaries aren't known and this always returns 1.
+*/
+uint8_t ShouldReadDisplayInfo(void);
+
+/*
+  Returns how many milliseconds ShouldReadDisplayInfo() and DisplayTime() have nothing to do for, 0 if they have
+  something to do now. A second boundary ends the wait early, so wake up on the SQW interrupt as well.
+*/
+uint32_t GetDisplayIdleMs(void);
+
+//Returns the counters of the flips at the second boundary.
+const DisplayFlipStats* GetDisplayFlipStats(void);
+
+//Returns the DISPLAY_FIELD_ bits of the parts of the info that are different.
+uint8_t GetChangedDisplayFields(const DisplayInfo* previous, const DisplayInfo* current);
+
+//Returns how long rendering the pages takes.
+const DisplayRenderStats* GetDisplayRenderStats(void);
+
+//Copies the values the diagnostics page shows. They appear with the next refresh of the page.
+void SetDisplayDiagnostics(const DisplayDiagnostics* diagnostics);
+
+/*
+  Redraws the whole current page. Call this after the LCD was re-initialized, since initialization clears the
+  display.
+*/
+void ReapplyDisplayedPage(void);
+
 #endif /* INC_DISPLAY_CONTROL_H_ */
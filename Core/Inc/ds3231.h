@@ -31,7 +31,11 @@
 #define DS3231_REG_ADDR_TEMP_MSB	 							0x11
 #define DS3231_REG_ADDR_TEMP_LSB	 							0x12
 
+//Alarm 1 isn't used, its seconds register keeps a byte for the firmware while the DS3231 runs on its battery.
+#define DS3231_REG_ADDR_USER_BYTE								DS3231_REG_ADDR_ALARM1_SECONDS
+
 //Initializes the DS3231 chip and the internal workings of the software as well.
+//The time and alarm registers are converted to 24h format if they are in 12h format, this driver only uses 24h.
 HAL_StatusTypeDef DS3231_Init(I2C_HandleTypeDef* handle);
 
 /*
@@ -46,10 +50,20 @@ HAL_StatusTypeDef DS3231_WriteToRegister(uint16_t registerAddress, uint8_t* buff
 */
 HAL_StatusTypeDef DS3231_ReadFromRegister(uint16_t registerAddress, uint8_t* buffer, uint16_t bufferSize);
 
+//Returns the number of bytes the two functions above have put on the I2C bus, including the address bytes.
+uint32_t DS3231_GetBusByteCount(void);
+
+//Number of registers from DS3231_REG_ADDR_SECONDS to DS3231_REG_ADDR_YEAR, see DS3231_EncodeTimeRegisters().
+#define DS3231_TIME_REGISTER_COUNT								7
+//Number of registers from DS3231_REG_ADDR_ALARM2_MINS to DS3231_REG_ADDR_ALARM2_HOURS, see DS3231_EncodeAlarmRegisters().
+#define DS3231_ALARM_REGISTER_COUNT								2
+
 /*
- Sets the time format of DS3231 to either 12h or 24h format.
+  Writes the count registers from firstRegister on that are different in current than in previous. Every run of
+  consecutive changed registers is written in one transaction, unchanged registers are never written. Adds the
+  number of transactions to transactions if it isn't NULL.
 */
-HAL_StatusTypeDef DS3231_SetTimeFormat(uint8_t is12hrFormat);
+HAL_StatusTypeDef DS3231_WriteChangedRegisters(uint16_t firstRegister, const uint8_t* previous, uint8_t* current, uint8_t count, uint8_t* transactions);
 
 //Returns the value in the seconds register.
 HAL_StatusTypeDef DS3231_ReadSeconds(uint8_t* result);
@@ -63,22 +77,12 @@ HAL_StatusTypeDef DS3231_ReadMinutes(uint8_t* result);
 //Writes the given value of minutes to DS3231's minutes register. Range is 00-59.
 HAL_StatusTypeDef DS3231_WriteMinutes(uint8_t value);
 
-//Returns the value in the hours register.
-//Any one of the pointers can be passed NULL if the caller doesn't care about that value.
-HAL_StatusTypeDef DS3231_ReadHours(uint8_t* result, uint8_t* is12HrMode, uint8_t* isPM);
+//Returns the value in the hours register. Range is 00-23.
+HAL_StatusTypeDef DS3231_ReadHours(uint8_t* result);
 
-//Writes the given value of hours to DS3231's minutes register. Range is 00-23. AM/PM calculation is done automatically if time format is 12h.
+//Writes the given value of hours to DS3231's hours register. Range is 00-23.
 HAL_StatusTypeDef DS3231_WriteHours(uint8_t value);
 
-//Reads whether DS3231 is working in 12h or 24h format. 1 indicates 12h format, 0 indicates 24h format.
-HAL_StatusTypeDef DS3231_Is12hrFormatEnabled(uint8_t* result);
-
-/*
-  Reads whether the current time is in AM or PM. The result is only
-  meaningful if DS3231 is operating in 12h format. 1 means PM, 0 means AM.
-*/
-HAL_StatusTypeDef DS3231_IsTimePM(uint8_t* result);
-
 //Reads days of the week infomation. Result is between 1 and 7.
 HAL_StatusTypeDef DS3231_ReadDayOfTheWeek(uint8_t* result);
 
@@ -115,6 +119,12 @@ HAL_StatusTypeDef DS3231_ReadControlRegister(uint8_t* result);
 //Writes into the control register of DS3231.
 HAL_StatusTypeDef DS3231_WriteToControlRegister(uint8_t value);
 
+/*
+  Outputs a 1Hz square wave on the INT/SQW pin. Its falling edge is when the seconds change. The alarm flags
+  still work, they just don't drive the pin anymore, which this project doesn't use anyway.
+*/
+HAL_StatusTypeDef DS3231_EnableSquareWave1Hz(void);
+
 //Reads the status register from DS3231.
 HAL_StatusTypeDef DS3231_ReadStatusRegister(uint8_t* result);
 
@@ -130,14 +140,13 @@ HAL_StatusTypeDef DS3231_ToggleAlarm(uint8_t value);
 /*
   Reads the currently set alarm time from DS3231.
   0 <= minutes <= 59
-  0 <= hours <= 23 for 24h format
-  0 <= hours <= 12 + AM/PM information for 12h format
+  0 <= hours <= 23
   Any one of the pointers can be passed NULL if the caller doesn't care about that result.
 */
-HAL_StatusTypeDef DS3231_ReadAlarmTime(uint8_t* hours, uint8_t* minutes, uint8_t* is12hFormat, uint8_t* isPM);
+HAL_StatusTypeDef DS3231_ReadAlarmTime(uint8_t* hours, uint8_t* minutes);
 
 //Sets an alarm time. Doesn't enable/disable the alarm. 0 <= hours <= 23, 0 <= minutes <= 59
-HAL_StatusTypeDef DS3231_SetAlarmTime(uint8_t hoursIn24hFormat, uint8_t minutes);
+HAL_StatusTypeDef DS3231_SetAlarmTime(uint8_t hours, uint8_t minutes);
 
 //result = 1 if time has come to sound the alarm. result = 0 otherwise.
 HAL_StatusTypeDef DS3231_IsAlarmTime(uint8_t* result);
@@ -150,4 +159,19 @@ HAL_StatusTypeDef DS3231_SignalAlarmTimePassed(void);
 //Reads the temperature bits from DS3231 and returns it without any processing whatsoever.
 HAL_StatusTypeDef DS3231_ReadTemperature(uint16_t* result);
 
+/*
+  Fills DS3231_TIME_REGISTER_COUNT registers with what the time and date registers hold for the given values.
+  Ranges are the same as for the write functions, year is 00-99. The century bit is 0.
+*/
+void DS3231_EncodeTimeRegisters(uint8_t* registers, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t dayOfTheWeek, uint8_t dayOfTheMonth, uint8_t month, uint8_t year);
+
+//Fills DS3231_ALARM_REGISTER_COUNT registers with what the alarm 2 time registers hold for the given time.
+void DS3231_EncodeAlarmRegisters(uint8_t* registers, uint8_t hours, uint8_t minutes);
+
+//Reads the byte kept in DS3231_REG_ADDR_USER_BYTE.
+HAL_StatusTypeDef DS3231_ReadUserByte(uint8_t* result);
+
+//Writes the byte kept in DS3231_REG_ADDR_USER_BYTE.
+HAL_StatusTypeDef DS3231_WriteUserByte(uint8_t value);
+
 #endif /* INC_DS3231_H_ */
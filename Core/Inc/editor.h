@@ -13,15 +13,29 @@
 #include "stdint.h"
 #include "stm32f1xx_hal.h"
 
+typedef struct EditorStats
+{
+	uint32_t increments; //Decrements included
+	uint32_t lastIncrementCycles; //Incrementing, rendering and writing the field and moving the cursor back
+	uint32_t maxIncrementCycles;
+	uint32_t lastIncrementCharacters; //Characters written to the LCD by the last increment
+} EditorStats;
+
 //Handles the display in editing mode.
 void HandleDisplayDuringEditing(const DisplayInfo* info);
 //Handles incrementing the values in the editing mode.
 void IncrementCurrentlyEditedValue(DisplayInfo* info);
-//Starts the editing sequence.
-void StartEditing(void);
+//Handles decrementing the values in the editing mode.
+void DecrementCurrentlyEditedValue(DisplayInfo* info);
+//Starts the editing sequence from the given values, they are remembered for GetInfoBeforeEditing().
+void StartEditing(const DisplayInfo* info);
 //Ends the editing.
 void EndEditing(void);
 //Switches to the next value to edit. Returns 1 if wrapped back to the beginning. Returns 0 otherwise.
 uint8_t SwitchNextToEdit(void);
+//Returns the values editing started from, to find out which ones were changed.
+const DisplayInfo* GetInfoBeforeEditing(void);
+//Returns how long the increments take.
+const EditorStats* GetEditorStats(void);
 
 #endif /* INC_EDITOR_H_ */
@@ -0,0 +1,42 @@
+/*
+ * field_format.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef INC_FIELD_FORMAT_H_
+#define INC_FIELD_FORMAT_H_
+
+#include <stdint.h>
+
+/*
+  Fixed-width formatting of the clock fields without snprintf. Every function writes into out without a null
+  terminator and returns the position right after the last written character, so calls can be chained. The
+  caller makes sure the buffer is large enough, the widths below are all fixed.
+*/
+
+//Writes value % 100 as two digits.
+char* Format_TwoDigits(char* out, uint32_t value);
+
+//Writes value % 10000 as four digits.
+char* Format_FourDigits(char* out, uint32_t value);
+
+//Writes HH:MM.
+char* Format_Time(char* out, uint8_t hours, uint8_t minutes);
+
+/*
+  Writes value right aligned in width characters, padded with spaces. Only the lowest width digits are written if
+  it doesn't fit. A width of 0 writes as many digits as needed, at most 10.
+*/
+char* Format_Unsigned(char* out, uint32_t value, uint8_t width);
+
+//Writes a value in hundredths with a sign and at least two integer digits, like +05.25 or -12.75.
+char* Format_Centi(char* out, int32_t centi);
+
+//Copies text, without its null terminator.
+char* Format_Text(char* out, const char* text);
+
+//Writes count copies of character.
+char* Format_Fill(char* out, char character, uint8_t count);
+
+#endif /* INC_FIELD_FORMAT_H_ */
@@ -15,6 +15,178 @@
 
 #define arr_size(a)			(sizeof(a) / sizeof((a)[0]))
 
+//Set to 1 to talk to the chip over D4-D7 only. D0-D3 of the LCD are left unconnected in this mode, which puts the
+//whole bus (RS, RW, EN, D4-D7) on the control port and frees the D0-D3 pins of the MCU.
+#ifndef LCD_USE_4BIT_MODE
+#define LCD_USE_4BIT_MODE					0
+#endif
+
+//Set to 1 if RW of the LCD is tied low. Nothing is read from the chip in this mode, instructions are scheduled by
+//their execution times instead of the busy flag. The RW pin of the MCU isn't touched and can be used for something
+//else. ReadByte() isn't available, ReadAddressCounter() returns the address counter the driver keeps track of.
+#ifndef LCD_USE_WRITE_ONLY_MODE
+#define LCD_USE_WRITE_ONLY_MODE				0
+#endif
+
+/*
+  Geometry of the panel. The chip always has two DDRAM lines of 40 characters at 0x00 and 0x40. Panels with 4 rows
+  split each of them over two rows: rows 1 and 3 are the first DDRAM line, rows 2 and 4 the second one. Select one
+  of the LCD_GEOMETRY_ values, everything below is derived from it at compile time.
+*/
+#define LCD_GEOMETRY_16X2					0
+#define LCD_GEOMETRY_20X4					1
+#define LCD_GEOMETRY_16X4					2
+#define LCD_GEOMETRY_40X2					3
+
+#ifndef LCD_GEOMETRY
+#define LCD_GEOMETRY						LCD_GEOMETRY_16X2
+#endif
+
+#if LCD_GEOMETRY == LCD_GEOMETRY_16X2
+#define LCD_COLUMNS							16
+#define LCD_ROWS							2
+#elif LCD_GEOMETRY == LCD_GEOMETRY_20X4
+#define LCD_COLUMNS							20
+#define LCD_ROWS							4
+#elif LCD_GEOMETRY == LCD_GEOMETRY_16X4
+#define LCD_COLUMNS							16
+#define LCD_ROWS							4
+#elif LCD_GEOMETRY == LCD_GEOMETRY_40X2
+#define LCD_COLUMNS							40
+#define LCD_ROWS							2
+#else
+#error "Unknown LCD_GEOMETRY"
+#endif
+
+#define LCD_DDRAM_LINE_LENGTH				40
+//DDRAM address of the first character of a row (1-based). Folds to a constant when row is one.
+#define LCD_ROW_ADDRESS(row)				((((row) - 1) & 1 ? 0x40 : 0x00) + (((row) - 1) >> 1) * LCD_COLUMNS)
+//Characters that can be addressed from the start of a row. On 2 row panels this includes the DDRAM columns
+//outside the screen, on 4 row panels the row ends where the next one starts.
+#define LCD_ROW_LENGTH						(LCD_ROWS == 2 ? LCD_DDRAM_LINE_LENGTH : LCD_COLUMNS)
+
+#define LCD_FOSC_NOMINAL_HZ					270000
+//Slowest oscillator the datasheet allows. Busy flag waits give up after the worst-case time at this frequency.
+#define LCD_FOSC_MIN_HZ						190000
+//Oscillator frequency of the chip. Execution times in the datasheet are given for 270 kHz, the write-only mode and
+//tADD are scaled by this. Nothing catches a slow chip without the busy flag, so the default is the slowest one. If
+//your LCD is measured to run faster, define this as the lowest frequency it was measured at.
+#ifndef LCD_FOSC_HZ
+#define LCD_FOSC_HZ							LCD_FOSC_MIN_HZ
+#endif
+//Execution times at LCD_FOSC_NOMINAL_HZ, in us.
+#define LCD_INSTRUCTION_TIME_US				37
+#define LCD_LONG_INSTRUCTION_TIME_US		1520 //Clear display and return home
+#define LCD_DATA_WRITE_TIME_US				41 //37 us + tADD of 4 us for the address counter update
+
+//Set to 1 to let frames (see LCD_BeginFrame) be streamed to the LCD by TIM3 + DMA1 without the CPU.
+#ifndef LCD_USE_DMA_STREAMING
+#define LCD_USE_DMA_STREAMING				1
+#endif
+
+//An execution time from the datasheet scaled to LCD_FOSC_MIN_HZ, rounded up. Like the busy flag timeouts.
+#define LCD_US_AT_FOSC_MIN(us)				(((us) * LCD_FOSC_NOMINAL_HZ + LCD_FOSC_MIN_HZ - 1) / LCD_FOSC_MIN_HZ)
+//Time a streamed instruction occupies the bus, in us. There is no busy flag to poll while streaming, so it has to
+//cover a data write on the slowest chip: 59 us.
+#define LCD_DMA_INSTRUCTION_PERIOD_US		LCD_US_AT_FOSC_MIN(LCD_DATA_WRITE_TIME_US)
+//Same for clear display and return home, which are padded with idle steps.
+#define LCD_DMA_LONG_INSTRUCTION_PERIOD_US	LCD_US_AT_FOSC_MIN(LCD_LONG_INSTRUCTION_TIME_US)
+//Every bus cycle takes 3 steps of a streamed frame: data setup, EN high and EN low. 4-bit mode needs two bus
+//cycles per instruction.
+#if LCD_USE_4BIT_MODE
+#define LCD_DMA_STEPS_PER_INSTRUCTION		6
+#else
+#define LCD_DMA_STEPS_PER_INSTRUCTION		3
+#endif
+//Rounded up, so that the steps of an instruction never add up to less than its period.
+#define LCD_DMA_STEP_PERIOD_US \
+	((LCD_DMA_INSTRUCTION_PERIOD_US + LCD_DMA_STEPS_PER_INSTRUCTION - 1) / LCD_DMA_STEPS_PER_INSTRUCTION)
+//Number of steps that can be buffered. Each step takes 8 bytes of RAM (4 bytes in 4-bit mode). Longer frames are streamed in chunks.
+#define LCD_DMA_MAX_STEPS					224
+
+//Consecutive busy flag timeouts after which the LCD is considered absent and isn't talked to anymore.
+#define LCD_TIMEOUTS_UNTIL_ABSENT			3
+//How often LCD_ServiceHealth() tries to re-initialize an LCD that isn't OK.
+#define LCD_REINIT_RETRY_PERIOD_MS			1000
+
+typedef enum LCD_Health
+{
+	LCD_HEALTH_OK = 0,
+	LCD_HEALTH_DEGRADED, //A busy flag wait timed out, the contents of the display can't be trusted.
+	LCD_HEALTH_ABSENT, //The chip doesn't respond. Everything except re-initialization is skipped.
+} LCD_Health;
+
+typedef struct LCD_FaultStats
+{
+	uint32_t busyTimeouts;
+	uint32_t reinitAttempts;
+	uint32_t reinitSuccesses;
+	uint32_t timesAbsent; //How many times the LCD went absent
+} LCD_FaultStats;
+
+typedef struct LCD_WriteStats
+{
+	uint32_t buffersWritten;
+	uint32_t charactersWritten;
+	uint32_t cycles; //CPU cycles spent writing all the characters so far, including busy waits.
+	uint32_t lastCyclesPerCharacter;
+} LCD_WriteStats;
+
+typedef struct LCD_DMAStats
+{
+	uint32_t framesStreamed;
+	uint32_t instructionsStreamed;
+	uint32_t stepsStreamed;
+	uint32_t lastFrameSteps; //The bus is busy for lastFrameSteps * LCD_DMA_STEP_PERIOD_US microseconds.
+	uint32_t lastFrameCpuCycles; //CPU cycles spent building and starting the last frame.
+} LCD_DMAStats;
+
+//Set to 0 to remove the per-primitive cycle counters below from the driver's hot paths.
+#ifndef LCD_COLLECT_STATS
+#define LCD_COLLECT_STATS					1
+#endif
+
+//Instruction classes in the order of the bit that identifies them, data and address accesses come last.
+typedef enum LCD_InstructionClass
+{
+	LCD_INSTRUCTION_CLEAR = 0,
+	LCD_INSTRUCTION_RETURN_HOME,
+	LCD_INSTRUCTION_ENTRY_MODE,
+	LCD_INSTRUCTION_DISPLAY_CONTROL,
+	LCD_INSTRUCTION_SHIFT,
+	LCD_INSTRUCTION_FUNCTION_SET,
+	LCD_INSTRUCTION_SET_CGRAM_ADDRESS,
+	LCD_INSTRUCTION_SET_DDRAM_ADDRESS,
+	LCD_INSTRUCTION_DATA_WRITE,
+	LCD_INSTRUCTION_DATA_READ,
+	LCD_INSTRUCTION_ADDRESS_READ, //Busy flag polls aren't counted here, see busyPolls.
+	LCD_INSTRUCTION_CLASS_COUNT,
+} LCD_InstructionClass;
+
+/*
+  Everything the driver knows about where its time goes. All cycle counts are CPU (DWT) cycles. busyWaitCycles
+  includes the busy flag polls, which also show up in busReadCycles and portModeSwitchCycles. Likewise, the pin
+  mode switches around a bus write are part of busWriteCycles. With LCD_COLLECT_STATS disabled, the counters
+  from instructionCounts to delayCycles stay at 0.
+*/
+typedef struct LCD_DebugStats
+{
+	uint32_t instructionCounts[LCD_INSTRUCTION_CLASS_COUNT];
+	uint32_t busyPolls;
+	uint32_t busyWaitCycles; //Spent waiting for the busy flag to turn off or for the execution time to pass.
+	uint32_t busWriteCycles; //Spent actually driving instructions onto the bus.
+	uint32_t busReadCycles;
+	uint32_t portModeSwitches;
+	uint32_t portModeSwitchCycles;
+	uint32_t delayCycles; //Spent in fixed timing delays (tAS, PWeh, tADD, hold times).
+	uint32_t framesDrawn;
+	uint32_t charactersInLastFrame;
+	uint32_t maxCharactersPerFrame;
+	LCD_WriteStats write;
+	LCD_DMAStats dma; //Stays 0 without LCD_USE_DMA_STREAMING.
+	LCD_FaultStats faults;
+} LCD_DebugStats;
+
 //Instruction bits correspond to RS-RW-D7-D6-D5-D4-D3-D2-D1-D0 in order. Big endian. Only the lower 10 bits of the instruction are used.
 void SendInstruction(uint16_t instruction);
 
@@ -37,10 +209,10 @@ void DisplayAndCursorControl(uint8_t display, uint8_t cursor, uint8_t blink);
 //Moves cursor to the right or to the left
 void ShiftCursor(uint8_t shiftRight);
 
-//Moves the cursor to the given position on the given line. 1 <= line <= 2 and 1 <= position <= 40.
+//Moves the cursor to the given position on the given line. 1 <= line <= LCD_ROWS and 1 <= position <= LCD_ROW_LENGTH.
 void MoveCursor(uint8_t line, uint8_t position);
 
-//Returns the line the cursor is currently on. Returns 1 or 2 upon success, another value upon error.
+//Returns the line the cursor is currently on. Returns 1 to LCD_ROWS upon success, another value upon error.
 uint8_t GetCurrentLine();
 
 //Shifts display to the right or to the left
@@ -66,6 +238,21 @@ void WriteCharacter(uint8_t character);
 //Writes the given string on the screen
 void WriteString(const char* text);
 
+/*
+  Writes length bytes starting from the given position (same ranges as MoveCursor). The address is set once and
+  the bytes are streamed with a single busy check per byte. Inside a frame, the bytes are queued.
+*/
+void LCD_WriteBuffer(uint8_t line, uint8_t column, const uint8_t* buffer, size_t length);
+
+/*
+  Uploads the 8 rows of a custom character into the given CGRAM slot (0-7). Only the lowest 5 bits of each row
+  are used. The address counter points to CGRAM afterwards, set a DDRAM address before writing characters again.
+*/
+void LCD_WriteCGRAM(uint8_t slot, const uint8_t* pattern);
+
+//Returns the counters of the byte streaming done by WriteString, LCD_WriteBuffer and LCD_WriteCGRAM.
+const LCD_WriteStats* LCD_GetWriteStats(void);
+
 //Sets a CGRAM address for the internal address counter of the chip. CGRAM data is sent and received after this
 //setting. Only the lowest 6 bits are used.
 void SetCGRAMAddress(uint8_t address);
@@ -76,6 +263,7 @@ void SetDDRAMAddress(uint8_t address);
 
 //Returns whether the chip is busy executing an internal operation. You shouldn't need to explicitly check for this,
 //each function provided already checks if the chip is busy before sending the instruction.
+//In write-only mode, this is answered by the execution time model and doesn't touch the bus.
 uint8_t IsBusy();
 
 //Reads the current address counter value of the chip.
@@ -85,4 +273,56 @@ uint8_t ReadAddressCounter();
 //Either CGRAM Address or DDRAM Address needs to be set before calling this function.
 uint8_t ReadByte();
 
+/*
+  Starts a frame. Until the matching LCD_EndFrame(), the functions above don't touch the bus and their instructions
+  are queued instead. Frames are write-only, so don't read from the chip (IsBusy, ReadByte etc.) inside a frame.
+  Frames can be nested. Without LCD_USE_DMA_STREAMING, this does nothing and instructions are sent immediately.
+*/
+void LCD_BeginFrame(void);
+
+/*
+  Ends the frame and starts streaming the queued instructions in the background. The next access to the bus
+  waits for the stream to finish.
+*/
+void LCD_EndFrame(void);
+
+/*
+  Returns 1 if the next instruction can be sent right away, 0 if sending it would have to wait. Lets the caller do
+  something useful instead of spinning inside the driver, mainly in write-only mode.
+*/
+uint8_t LCD_IsReady(void);
+
+//Returns the health of the LCD. Always OK in write-only mode, since nothing can be read to detect faults.
+LCD_Health LCD_GetHealth(void);
+
+/*
+  Call this periodically. If the LCD isn't OK, it is re-initialized with Init16x2LCD() at most once every
+  LCD_REINIT_RETRY_PERIOD_MS. Returns 1 if the LCD has just been re-initialized, in which case the caller needs
+  to redraw everything. Returns 0 otherwise.
+*/
+uint8_t LCD_ServiceHealth(void);
+
+//Returns how many milliseconds LCD_ServiceHealth() has nothing to do for, UINT32_MAX while the LCD is OK.
+uint32_t LCD_GetHealthIdleMs(void);
+
+/*
+  Marks the LCD as degraded so that the next LCD_ServiceHealth() call re-initializes it right away. For callers
+  that found the state of the chip to be wrong by other means than a busy flag timeout.
+*/
+void LCD_RequestReinit(void);
+
+//Returns the fault counters.
+const LCD_FaultStats* LCD_GetFaultStats(void);
+
+//Returns 1 while a frame is being streamed to the chip, 0 otherwise.
+uint8_t LCD_IsStreaming(void);
+
+//Returns all of the statistics collected by the driver. The counters wrap around, compare differences.
+const LCD_DebugStats* LCD_GetDebugStats(void);
+
+#if LCD_USE_DMA_STREAMING
+//Returns the counters collected while streaming frames.
+const LCD_DMAStats* LCD_GetDMAStats(void);
+#endif
+
 #endif /* INC_LCD_HD44780U_H_ */
@@ -0,0 +1,126 @@
+/*
+ * lcd_framebuffer.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef INC_LCD_FRAMEBUFFER_H_
+#define INC_LCD_FRAMEBUFFER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lcd_HD44780U.h"
+
+#define FRAMEBUFFER_LINES				LCD_ROWS
+#define FRAMEBUFFER_COLUMNS				LCD_COLUMNS
+
+/*
+  With double buffering, the DDRAM columns right after the visible ones hold a second bank. The next frame is
+  written into the hidden bank while the other one is shown, then Framebuffer_Flip() shifts the display over to
+  it. Without it, only the visible columns are used and the display is never shifted. The second bank only fits
+  on 2 row panels of at most 20 columns, the shift would move the rows of a 4 row panel into each other.
+*/
+#define FRAMEBUFFER_CAN_DOUBLE_BUFFER	(LCD_ROWS == 2 && 2 * LCD_COLUMNS <= LCD_DDRAM_LINE_LENGTH)
+#ifndef FRAMEBUFFER_USE_DOUBLE_BUFFERING
+#define FRAMEBUFFER_USE_DOUBLE_BUFFERING	FRAMEBUFFER_CAN_DOUBLE_BUFFER
+#endif
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING && !FRAMEBUFFER_CAN_DOUBLE_BUFFER
+#error "Double buffering isn't possible with this LCD_GEOMETRY"
+#endif
+
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING
+#define FRAMEBUFFER_BANK_COUNT			2
+#else
+#define FRAMEBUFFER_BANK_COUNT			1
+#endif
+#define FRAMEBUFFER_BANK_OFFSET			FRAMEBUFFER_COLUMNS //DDRAM columns between the banks
+
+/*
+  Unchanged characters between two changed ones are rewritten if there are at most this many of them. Rewriting
+  one character costs as much as the address set that skipping it would take.
+*/
+#ifndef FRAMEBUFFER_MERGE_GAP
+#define FRAMEBUFFER_MERGE_GAP			1
+#endif
+
+/*
+  The scrubber reads DDRAM back and repairs the characters that don't match what was written, e.g. after ESD or a
+  supply glitch. It reads at most this many characters per second, which sets its cost: a read takes about as
+  long as a write. 0 disables it. Reading isn't possible in write-only mode, the scrubber is left out there.
+*/
+#ifndef FRAMEBUFFER_SCRUB_CHARACTERS_PER_SECOND
+#define FRAMEBUFFER_SCRUB_CHARACTERS_PER_SECOND	32
+#endif
+#define FRAMEBUFFER_USE_SCRUBBER		(!LCD_USE_WRITE_ONLY_MODE && FRAMEBUFFER_SCRUB_CHARACTERS_PER_SECOND > 0)
+//Characters read back in one go, from a single line of one bank.
+#ifndef FRAMEBUFFER_SCRUB_SLICE_LENGTH
+#define FRAMEBUFFER_SCRUB_SLICE_LENGTH	8
+#endif
+
+typedef struct FramebufferStats
+{
+	uint32_t flushes; //Flushes that had something to write
+	uint32_t charactersWritten;
+	uint32_t addressSets;
+	uint32_t lastCharactersWritten;
+	uint32_t flips;
+	uint32_t scrubbedCharacters; //Read back by the scrubber
+	uint32_t repairedCharacters; //Found wrong and rewritten
+	uint32_t scrubReinits; //Times the chip looked reset and re-initialization was requested
+	uint32_t lastScrubCycles;
+} FramebufferStats;
+
+//Fills the framebuffer with spaces. The screen doesn't change until Framebuffer_Flush().
+void Framebuffer_Clear(void);
+
+//Writes length characters into the framebuffer starting from the given position (1-based). Characters that
+//don't fit on the line are dropped.
+void Framebuffer_Write(uint8_t line, uint8_t column, const char* text, size_t length);
+
+//Writes a single character code, e.g. one returned by Glyph_Acquire().
+void Framebuffer_WriteCharacter(uint8_t line, uint8_t column, uint8_t character);
+
+/*
+  Writes the characters that differ from what is on the screen, in as few runs as possible, within a single LCD
+  frame. Moves the cursor. Returns the number of characters written.
+*/
+uint32_t Framebuffer_Flush(void);
+
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING
+//Same as Framebuffer_Flush(), but writes into the hidden bank. Nothing changes on the screen.
+uint32_t Framebuffer_FlushHidden(void);
+
+/*
+  Makes the hidden bank visible. Takes the same time no matter how much changed: a single return home
+  instruction in one direction, a burst of shifts in the other.
+*/
+void Framebuffer_Flip(void);
+#endif
+
+//Moves the cursor to the given position (1-based) on the visible bank.
+void Framebuffer_MoveCursor(uint8_t line, uint8_t column);
+
+#if FRAMEBUFFER_USE_SCRUBBER
+/*
+  Call this when there is nothing else to do. If the rate allows and the LCD is idle, reads back the next slice of
+  DDRAM and rewrites the characters that don't match. If the address counter doesn't move as expected or the
+  slice looks like the chip has been reset, requests re-initialization through LCD_RequestReinit(). Restores the
+  cursor afterwards.
+*/
+void Framebuffer_Scrub(void);
+
+//Returns how many milliseconds it takes until the rate allows Framebuffer_Scrub() to read the next slice.
+//UINT32_MAX while the LCD isn't OK, it is re-initialized instead.
+uint32_t Framebuffer_GetScrubIdleMs(void);
+#endif
+
+/*
+  Forgets what is on the screen, the next flush writes everything. Call this after the LCD was re-initialized,
+  which also means the first bank is visible again.
+*/
+void Framebuffer_Invalidate(void);
+
+//Returns the counters of the flushes.
+const FramebufferStats* Framebuffer_GetStats(void);
+
+#endif /* INC_LCD_FRAMEBUFFER_H_ */
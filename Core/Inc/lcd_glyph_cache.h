@@ -0,0 +1,57 @@
+/*
+ * lcd_glyph_cache.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef INC_LCD_GLYPH_CACHE_H_
+#define INC_LCD_GLYPH_CACHE_H_
+
+#include <stdint.h>
+
+//How many different glyphs can be registered. Only 8 of them can be in CGRAM at the same time.
+#ifndef GLYPH_CACHE_MAX_GLYPHS
+#define GLYPH_CACHE_MAX_GLYPHS			16
+#endif
+
+#define GLYPH_CACHE_SLOT_COUNT			8
+//The slots are shown by the character codes 0-7 and again by 8-15. The second set is used, code 0 would end the
+//C strings the glyphs are written in.
+#define GLYPH_CACHE_FIRST_CHARACTER		8
+
+//Returned by Glyph_Acquire() for glyphs that aren't registered, so that at least something sensible is shown.
+#define GLYPH_CACHE_UNKNOWN_CHARACTER	'?'
+
+typedef struct GlyphCacheStats
+{
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions; //Misses that had to throw a glyph out of CGRAM
+	uint32_t uploadCycles; //CPU cycles spent uploading all the glyphs so far
+	uint32_t lastUploadCycles;
+} GlyphCacheStats;
+
+/*
+  Registers a 5x8 bitmap (8 rows, lowest 5 bits of each row are used) under the given ID, which needs to be
+  smaller than GLYPH_CACHE_MAX_GLYPHS. The bitmap isn't copied, it needs to stay valid. Re-registering an ID
+  replaces its bitmap. Returns 1 on success, 0 if the ID is out of range.
+*/
+uint8_t Glyph_Register(uint8_t id, const uint8_t* bitmap);
+
+/*
+  Returns the character code (8-15) to write into DDRAM to show the glyph with the given ID. If the glyph isn't in
+  CGRAM, it is uploaded into the least recently used slot. This moves the address counter into CGRAM, so call
+  this before setting the cursor to where the glyph will be written.
+  The glyph that gets evicted changes on the screen as well, so a single screen can't show more than
+  GLYPH_CACHE_SLOT_COUNT different glyphs.
+*/
+uint8_t Glyph_Acquire(uint8_t id);
+
+//Forgets what is in CGRAM, every glyph is uploaded again on its next use. Happens by itself after the LCD is
+//re-initialized by LCD_ServiceHealth().
+void Glyph_InvalidateCache(void);
+
+//Returns the hit/miss and upload time counters.
+const GlyphCacheStats* Glyph_GetCacheStats(void);
+
+#endif /* INC_LCD_GLYPH_CACHE_H_ */
@@ -0,0 +1,75 @@
+/*
+ * lcd_marquee.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef INC_LCD_MARQUEE_H_
+#define INC_LCD_MARQUEE_H_
+
+#include <stdint.h>
+#include "lcd_HD44780U.h"
+
+//A full screen marquee can't be longer than a DDRAM line.
+#define MARQUEE_MAX_LENGTH				LCD_DDRAM_LINE_LENGTH
+
+#ifndef MARQUEE_STEP_PERIOD_MS
+#define MARQUEE_STEP_PERIOD_MS			300
+#endif
+
+//Spaces between the end of a windowed message and its start coming around again.
+#define MARQUEE_WINDOW_GAP				3
+
+typedef struct MarqueeStats
+{
+	uint32_t fullScreenSteps;
+	uint32_t lastFullScreenStepCycles; //A single shift instruction, including its busy wait
+	uint32_t windowSteps;
+	uint32_t lastWindowStepCycles; //Rendering the page the window is on and flushing it
+	uint32_t lastWindowStepCharacters; //Characters the flush had to write
+} MarqueeStats;
+
+/*
+  Windowed marquee, scrolls a message through a part of a single line of the framebuffer. The other line and the
+  rest of the page stay still, but every step rewrites the window.
+*/
+typedef struct Marquee
+{
+	char text[MARQUEE_MAX_LENGTH];
+	uint8_t length;
+	uint32_t startTick;
+	uint32_t lastStep; //Step the window was last rendered at
+} Marquee;
+
+//Sets the message of the marquee. Scrolling restarts only if the message is different.
+void Marquee_SetText(Marquee* marquee, const char* text);
+
+/*
+  Writes the part of the message that should be visible now into the framebuffer, width characters starting
+  from the given position. Messages that fit aren't scrolled. The position only depends on the time, so the
+  page just needs to be rendered at least every MARQUEE_STEP_PERIOD_MS. Returns 1 if the window moved since the
+  last call, 0 otherwise.
+*/
+uint8_t Marquee_RenderWindow(Marquee* marquee, uint8_t line, uint8_t column, uint8_t width);
+
+//Records the cost of a rendered frame in which a window moved.
+void Marquee_RecordWindowStep(uint32_t cycles, uint32_t characters);
+
+/*
+  Full screen marquee. The message is written into the whole DDRAM line and scrolled with the display shift
+  instruction, one instruction per step no matter how long the message is. The shift moves both lines, so the
+  other line is cleared and the framebuffer can't be used until Marquee_StopFullScreen(). On 4 row panels a DDRAM
+  line spans two rows, so the message continues on the row below the next one.
+*/
+void Marquee_StartFullScreen(uint8_t line, const char* text);
+
+//Steps the full screen marquee if MARQUEE_STEP_PERIOD_MS has passed. Call this periodically.
+void Marquee_ServiceFullScreen(void);
+
+//Stops the full screen marquee and shifts the display back. The screen needs to be redrawn afterwards.
+void Marquee_StopFullScreen(void);
+
+//Returns the per-step costs of both kinds of marquees.
+const MarqueeStats* Marquee_GetStats(void);
+
+#endif /* INC_LCD_MARQUEE_H_ */
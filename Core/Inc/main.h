@@ -61,14 +61,19 @@ void Error_Handler(void);
 #define OnboardLED_GPIO_Port GPIOC
 #define PAGE_TOGGLE_Pin GPIO_PIN_0
 #define PAGE_TOGGLE_GPIO_Port GPIOA
+#define PAGE_TOGGLE_EXTI_IRQn EXTI0_IRQn
 #define ALARM_TOGGLE_Pin GPIO_PIN_1
 #define ALARM_TOGGLE_GPIO_Port GPIOA
+#define ALARM_TOGGLE_EXTI_IRQn EXTI1_IRQn
 #define HOUR_FORMAT_CHANGE_Pin GPIO_PIN_2
 #define HOUR_FORMAT_CHANGE_GPIO_Port GPIOA
+#define HOUR_FORMAT_CHANGE_EXTI_IRQn EXTI2_IRQn
 #define EDIT_CHOICE_Pin GPIO_PIN_3
 #define EDIT_CHOICE_GPIO_Port GPIOA
+#define EDIT_CHOICE_EXTI_IRQn EXTI3_IRQn
 #define INCREMENT_EDITED_VALUE_Pin GPIO_PIN_4
 #define INCREMENT_EDITED_VALUE_GPIO_Port GPIOA
+#define INCREMENT_EDITED_VALUE_EXTI_IRQn EXTI4_IRQn
 #define Pin_RS_Pin GPIO_PIN_12
 #define Pin_RS_GPIO_Port GPIOB
 #define Pin_RW_Pin GPIO_PIN_13
@@ -95,6 +100,10 @@ void Error_Handler(void);
 #define Pin_D7_GPIO_Port GPIOB
 
 /* USER CODE BEGIN Private defines */
+//1Hz square wave output of the DS3231. Open drain, pulled up internally.
+#define SQW_Pin GPIO_PIN_10
+#define SQW_GPIO_Port GPIOB
+#define SQW_EXTI_IRQn EXTI15_10_IRQn
 
 /* USER CODE END Private defines */
 
@@ -0,0 +1,219 @@
+/*
+ * button_gesture.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <button_gesture.h>
+#include "stm32f1xx_hal.h"
+
+typedef enum GestureState
+{
+	GESTURE_STATE_IDLE = 0,
+	GESTURE_STATE_DOWN, //Pressed, a click or a long press
+	GESTURE_STATE_WAIT_SECOND_PRESS, //Released after a click, maybe the first one of a double click
+	GESTURE_STATE_SECOND_DOWN, //Pressed again, a double click once released
+	GESTURE_STATE_LONG_DOWN, //Held after a long press, repeating
+	GESTURE_STATE_COUNT,
+} GestureState;
+
+typedef enum GestureInput
+{
+	GESTURE_INPUT_PRESS = 0,
+	GESTURE_INPUT_RELEASE,
+	GESTURE_INPUT_TIMEOUT,
+	GESTURE_INPUT_COUNT,
+} GestureInput;
+
+typedef enum GestureTimer
+{
+	GESTURE_TIMER_NONE = 0, //Disarms the timer
+	GESTURE_TIMER_KEEP, //Leaves the timer as it is
+	GESTURE_TIMER_DOUBLE_CLICK,
+	GESTURE_TIMER_LONG_PRESS,
+	GESTURE_TIMER_REPEAT,
+} GestureTimer;
+
+#define GESTURE_NONE		0xFF //No gesture is reported
+
+typedef struct GestureTransition
+{
+	uint8_t nextState;
+	uint8_t gesture; //ButtonGestureType, or GESTURE_NONE
+	uint8_t timer; //GestureTimer started in the next state
+} GestureTransition;
+
+/*
+  What every input does in every state. A press while pressed or a release while released can't come from the
+  debounced events, those keep everything as it is.
+*/
+static const GestureTransition transitions[GESTURE_STATE_COUNT][GESTURE_INPUT_COUNT] =
+{
+	[GESTURE_STATE_IDLE] =
+	{
+		[GESTURE_INPUT_PRESS] = { GESTURE_STATE_DOWN, GESTURE_NONE, GESTURE_TIMER_LONG_PRESS },
+		[GESTURE_INPUT_RELEASE] = { GESTURE_STATE_IDLE, GESTURE_NONE, GESTURE_TIMER_KEEP },
+		[GESTURE_INPUT_TIMEOUT] = { GESTURE_STATE_IDLE, GESTURE_NONE, GESTURE_TIMER_NONE },
+	},
+	[GESTURE_STATE_DOWN] =
+	{
+		[GESTURE_INPUT_PRESS] = { GESTURE_STATE_DOWN, GESTURE_NONE, GESTURE_TIMER_KEEP },
+		[GESTURE_INPUT_RELEASE] = { GESTURE_STATE_WAIT_SECOND_PRESS, GESTURE_NONE, GESTURE_TIMER_DOUBLE_CLICK },
+		[GESTURE_INPUT_TIMEOUT] = { GESTURE_STATE_LONG_DOWN, BUTTON_GESTURE_LONG_PRESS, GESTURE_TIMER_REPEAT },
+	},
+	[GESTURE_STATE_WAIT_SECOND_PRESS] =
+	{
+		[GESTURE_INPUT_PRESS] = { GESTURE_STATE_SECOND_DOWN, GESTURE_NONE, GESTURE_TIMER_NONE },
+		[GESTURE_INPUT_RELEASE] = { GESTURE_STATE_WAIT_SECOND_PRESS, GESTURE_NONE, GESTURE_TIMER_KEEP },
+		[GESTURE_INPUT_TIMEOUT] = { GESTURE_STATE_IDLE, BUTTON_GESTURE_CLICK, GESTURE_TIMER_NONE },
+	},
+	[GESTURE_STATE_SECOND_DOWN] =
+	{
+		[GESTURE_INPUT_PRESS] = { GESTURE_STATE_SECOND_DOWN, GESTURE_NONE, GESTURE_TIMER_KEEP },
+		[GESTURE_INPUT_RELEASE] = { GESTURE_STATE_IDLE, BUTTON_GESTURE_DOUBLE_CLICK, GESTURE_TIMER_NONE },
+		[GESTURE_INPUT_TIMEOUT] = { GESTURE_STATE_SECOND_DOWN, GESTURE_NONE, GESTURE_TIMER_NONE },
+	},
+	[GESTURE_STATE_LONG_DOWN] =
+	{
+		[GESTURE_INPUT_PRESS] = { GESTURE_STATE_LONG_DOWN, GESTURE_NONE, GESTURE_TIMER_KEEP },
+		[GESTURE_INPUT_RELEASE] = { GESTURE_STATE_IDLE, GESTURE_NONE, GESTURE_TIMER_NONE },
+		[GESTURE_INPUT_TIMEOUT] = { GESTURE_STATE_LONG_DOWN, BUTTON_GESTURE_REPEAT, GESTURE_TIMER_REPEAT },
+	},
+};
+
+//Replaces the wait for a second press of buttons without double clicks, there is nothing to wait for.
+static const GestureTransition clickOnRelease = { GESTURE_STATE_IDLE, BUTTON_GESTURE_CLICK, GESTURE_TIMER_NONE };
+
+//The event taken out of the queue that still waits for a timeout that expired before it.
+static ButtonEvent pendingEvent;
+static uint8_t hasPendingEvent = 0;
+
+static GestureButton* FindButton(GestureButton* buttons, uint8_t buttonCount, uint16_t gpioPin)
+{
+	for (uint8_t i = 0; i < buttonCount; i++)
+	{
+		if (buttons[i].gpioPin == gpioPin)
+		{
+			return &buttons[i];
+		}
+	}
+	return NULL;
+}
+
+static void StartTimer(GestureButton* button, uint8_t timer, uint32_t tick)
+{
+	uint16_t duration = 0;
+	switch (timer)
+	{
+	case GESTURE_TIMER_KEEP:
+		return;
+	case GESTURE_TIMER_DOUBLE_CLICK:
+		duration = button->timings->doubleClickMs;
+		button->timerArmed = 1;
+		break;
+	case GESTURE_TIMER_LONG_PRESS:
+		duration = button->timings->longPressMs;
+		button->timerArmed = duration != 0;
+		break;
+	case GESTURE_TIMER_REPEAT:
+		duration = button->timings->repeatPeriodMs;
+		button->timerArmed = duration != 0;
+		break;
+	default:
+		button->timerArmed = 0;
+		break;
+	}
+	button->timerDuration = duration;
+	button->timerStart = tick;
+}
+
+//Runs the transition of the input at tick. Returns 1 and fills gesture if the transition reports one.
+static uint8_t RunTransition(GestureButton* button, GestureInput input, uint32_t tick, ButtonGesture* gesture)
+{
+	const GestureTransition* transition = &transitions[button->state][input];
+	if (transition->timer == GESTURE_TIMER_DOUBLE_CLICK && button->timings->doubleClickMs == 0)
+	{
+		transition = &clickOnRelease;
+	}
+	button->state = transition->nextState;
+	StartTimer(button, transition->timer, tick);
+	if (transition->gesture == GESTURE_NONE)
+	{
+		return 0;
+	}
+	gesture->gpioPin = button->gpioPin;
+	gesture->type = (ButtonGestureType)transition->gesture;
+	gesture->tick = tick;
+	return 1;
+}
+
+//Signed, an event can be older than a timer that was restarted from now.
+static uint8_t HasTimerExpired(const GestureButton* button, uint32_t tick)
+{
+	return button->timerArmed && (int32_t)(tick - button->timerStart) >= (int32_t)button->timerDuration;
+}
+
+uint8_t PopButtonGesture(GestureButton* buttons, uint8_t buttonCount, ButtonGesture* gesture)
+{
+	//Timers are restarted from now, so a loop that was busy for a while gets one repeat instead of a burst of them.
+	uint32_t now = HAL_GetTick();
+	while (hasPendingEvent || PopButtonEvent(&pendingEvent))
+	{
+		hasPendingEvent = 1;
+		GestureButton* button = FindButton(buttons, buttonCount, pendingEvent.gpioPin);
+		if (button == NULL)
+		{
+			hasPendingEvent = 0;
+			continue;
+		}
+
+		//The event might have been queued for a while, a timeout that expired before it happened goes first. It is
+		//reported when it expired.
+		if (HasTimerExpired(button, pendingEvent.tick))
+		{
+			uint32_t expiredTick = button->timerStart + button->timerDuration;
+			if (RunTransition(button, GESTURE_INPUT_TIMEOUT, now, gesture))
+			{
+				gesture->tick = expiredTick;
+				return 1;
+			}
+			continue;
+		}
+
+		hasPendingEvent = 0;
+		GestureInput input = pendingEvent.type == BUTTON_EVENT_PRESSED ? GESTURE_INPUT_PRESS : GESTURE_INPUT_RELEASE;
+		if (RunTransition(button, input, pendingEvent.tick, gesture))
+		{
+			return 1;
+		}
+	}
+
+	for (uint8_t i = 0; i < buttonCount; i++)
+	{
+		if (HasTimerExpired(&buttons[i], now) && RunTransition(&buttons[i], GESTURE_INPUT_TIMEOUT, now, gesture))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+uint32_t GetButtonGestureIdleMs(const GestureButton* buttons, uint8_t buttonCount)
+{
+	uint32_t idleMs = UINT32_MAX;
+	uint32_t now = HAL_GetTick();
+	for (uint8_t i = 0; i < buttonCount; i++)
+	{
+		if (!buttons[i].timerArmed)
+		{
+			continue;
+		}
+		uint32_t elapsed = now - buttons[i].timerStart;
+		uint32_t remaining = elapsed >= buttons[i].timerDuration ? 0 : buttons[i].timerDuration - elapsed;
+		if (remaining < idleMs)
+		{
+			idleMs = remaining;
+		}
+	}
+	return idleMs;
+}
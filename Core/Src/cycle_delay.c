@@ -0,0 +1,38 @@
+/*
+ * cycle_delay.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <cycle_delay.h>
+
+//Cycles per microsecond of the current HCLK with the error margin, in 16.16 fixed point so that clocks which
+//aren't a whole number of MHz and the margin don't get rounded away.
+static uint32_t cyclesPerMicrosecondQ16 = 0;
+
+uint8_t Delay_Init(void)
+{
+	if (!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk))
+	{
+		//Don't reset the counter if it is already running, the timestamps taken so far would break.
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; //Enable debug trace
+		DWT->CYCCNT = 0; //Reset the cycle counter
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; //Enable the cycle counter
+	}
+
+	uint32_t hclk = HAL_RCC_GetHCLKFreq();
+	uint64_t hclkWithMargin = (uint64_t)hclk * (1000000 + DELAY_CLOCK_ERROR_PPM) / 1000000;
+	cyclesPerMicrosecondQ16 = (uint32_t)(((hclkWithMargin << 16) + 999999) / 1000000);
+	return hclk <= DELAY_CPU_CLOCK_HZ;
+}
+
+uint32_t Delay_MicrosecondsToCycles(uint32_t us)
+{
+	return (uint32_t)(((uint64_t)us * cyclesPerMicrosecondQ16 + 0xFFFF) >> 16);
+}
+
+void Delay_Microseconds(uint32_t us)
+{
+	uint32_t start = DWT->CYCCNT;
+	Delay_CyclesFrom(start, Delay_MicrosecondsToCycles(us));
+}
@@ -8,52 +8,188 @@
 #include <debounced_button.h>
 #include "stm32f1xx_hal.h"
 
+//The bank of the buttons initialized with InitButtonWithDefaults(), sampled from the SysTick interrupt.
+static ButtonBank buttons = { 0 };
+static uint8_t ticksSinceSample = 0;
+//Set by the button edges, cleared once every button settled. Starts set, in case a button is held at boot.
+static uint8_t isDebouncing = 1;
+
+//Written by the interrupt only at the head, read by the main loop only at the tail.
+static ButtonEvent eventQueue[BUTTON_EVENT_QUEUE_LENGTH];
+static volatile uint8_t eventHead = 0;
+static volatile uint8_t eventTail = 0;
+static ButtonEventStats eventStats = { 0 };
+static volatile uint32_t pressCount = 0;
+
+void ButtonBank_AddPin(ButtonBank* bank, GPIO_TypeDef* port, uint16_t pin, GPIO_PinState expectedSignalWhenPressed)
+{
+	assert_param(bank->port == NULL || bank->port == port);
+	bank->port = port;
+	bank->pins |= pin;
+	if (expectedSignalWhenPressed == GPIO_PIN_RESET)
+	{
+		bank->pressedWhenLow |= pin;
+	}
+	else
+	{
+		bank->pressedWhenLow &= ~pin;
+	}
+}
+
+void ButtonBank_Sample(ButtonBank* bank, uint16_t inputData)
+{
+	uint16_t pressed = (inputData ^ bank->pressedWhenLow) & bank->pins;
+
+	//Count the samples in a row that differ from the state, all pins at once. A pin whose sample matches its state
+	//has its counter cleared. The counter overflows on the 4th differing sample, which is when the state toggles.
+	uint16_t differs = pressed ^ bank->state;
+	bank->counterHigh = (bank->counterHigh ^ bank->counterLow) & differs;
+	bank->counterLow = ~bank->counterLow & differs;
+	uint16_t toggled = differs & ~(bank->counterLow | bank->counterHigh);
+
+	bank->state ^= toggled;
+	bank->pressedEdges |= toggled & bank->state;
+	bank->releasedEdges |= toggled & ~bank->state;
+}
+
+void ButtonBank_Update(ButtonBank* bank)
+{
+	uint32_t now = HAL_GetTick();
+	//A loop that was busy for longer only gets one sample, the missed ones would all read the same.
+	if (bank->port == NULL || (now - bank->lastSampleTick) < BUTTON_BANK_SAMPLE_PERIOD_MS)
+	{
+		return;
+	}
+	bank->lastSampleTick = now;
+	ButtonBank_Sample(bank, (uint16_t)bank->port->IDR);
+}
+
+//The bank might be sampled from an interrupt, the edges are taken with the interrupts masked.
+uint16_t ButtonBank_TakePressed(ButtonBank* bank, uint16_t pins)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint16_t pressed = bank->pressedEdges & pins;
+	bank->pressedEdges &= ~pins;
+	__set_PRIMASK(primask);
+	return pressed;
+}
+
+uint16_t ButtonBank_TakeReleased(ButtonBank* bank, uint16_t pins)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint16_t released = bank->releasedEdges & pins;
+	bank->releasedEdges &= ~pins;
+	__set_PRIMASK(primask);
+	return released;
+}
+
 DebouncedButton InitButtonWithDefaults(GPIO_TypeDef* gpioChannel,	uint16_t gpioPin, GPIO_PinState expectedSignalWhenPressed)
 {
 	DebouncedButton button = { 0 };
-	button.lastPressedTime = 0;
-	button.debounceTime = DEBOUNCED_BUTTON_DEFAULT_DEBOUNCE_TIME_MS;
-	button.gpioChannel = gpioChannel;
+	ButtonBank_AddPin(&buttons, gpioChannel, gpioPin, expectedSignalWhenPressed);
+	button.bank = &buttons;
 	button.gpioPin = gpioPin;
-	button.expectedSignalWhenPressed = expectedSignalWhenPressed;
-	button.lastPressState = !button.expectedSignalWhenPressed; //Accept initial state as not pressed
-	button.lastMeasurementTime = 0;
 	return button;
 }
 
+static void PushButtonEvent(uint16_t gpioPin, ButtonEventType type, uint32_t tick)
+{
+	uint8_t head = eventHead;
+	if ((uint8_t)(head - eventTail) >= BUTTON_EVENT_QUEUE_LENGTH)
+	{
+		eventStats.droppedEvents++;
+		return;
+	}
+	ButtonEvent* event = &eventQueue[head % BUTTON_EVENT_QUEUE_LENGTH];
+	event->gpioPin = gpioPin;
+	event->type = type;
+	event->tick = tick;
+	eventHead = head + 1; //Published only after the event is written
+	eventStats.events++;
+	if (type == BUTTON_EVENT_PRESSED)
+	{
+		pressCount++;
+	}
+}
+
+void SampleDebouncedButtonsFromISR(void)
+{
+	if (buttons.port == NULL || !isDebouncing || ++ticksSinceSample < BUTTON_BANK_SAMPLE_PERIOD_MS)
+	{
+		return;
+	}
+	ticksSinceSample = 0;
+
+	uint16_t stateBefore = buttons.state;
+	ButtonBank_Sample(&buttons, (uint16_t)buttons.port->IDR);
+	uint16_t toggled = stateBefore ^ buttons.state;
+	//All counters are cleared when every pin matches its debounced state, the next change comes with an edge.
+	if ((buttons.counterLow | buttons.counterHigh) == 0)
+	{
+		isDebouncing = 0;
+	}
+	uint32_t now = HAL_GetTick();
+	while (toggled != 0)
+	{
+		uint16_t pin = toggled & -toggled; //Lowest set bit
+		toggled &= ~pin;
+		PushButtonEvent(pin, (buttons.state & pin) ? BUTTON_EVENT_PRESSED : BUTTON_EVENT_RELEASED, now);
+	}
+}
+
+void SignalButtonEdgeFromISR(uint16_t gpioPin)
+{
+	if (buttons.pins & gpioPin)
+	{
+		isDebouncing = 1;
+	}
+}
+
+uint8_t PopButtonEvent(ButtonEvent* event)
+{
+	uint8_t tail = eventTail;
+	if (tail == eventHead)
+	{
+		return 0;
+	}
+	*event = eventQueue[tail % BUTTON_EVENT_QUEUE_LENGTH];
+	eventTail = tail + 1; //Frees the slot only after it is copied
+
+	uint32_t latency = HAL_GetTick() - event->tick;
+	eventStats.lastQueueLatencyMs = latency;
+	if (latency > eventStats.maxQueueLatencyMs)
+	{
+		eventStats.maxQueueLatencyMs = latency;
+	}
+	return 1;
+}
+
+uint8_t HasButtonEvents(void)
+{
+	return eventTail != eventHead;
+}
+
+uint32_t GetButtonPressCount(void)
+{
+	return pressCount;
+}
+
+const ButtonEventStats* GetButtonEventStats(void)
+{
+	return &eventStats;
+}
+
 ButtonState GetDebouncedButtonState(DebouncedButton* button)
 {
-    uint32_t now = HAL_GetTick();
-
-    uint8_t rawPressed = HAL_GPIO_ReadPin(button->gpioChannel, button->gpioPin) == button->expectedSignalWhenPressed;
-
-    // Button released
-    if (!rawPressed)
-    {
-        button->lastPressState = !button->expectedSignalWhenPressed;
-        return BUTTON_STATE_NOT_PRESSED;
-    }
-
-    // Debounce check
-    if ((now - button->lastPressedTime) < button->debounceTime)
-    {
-        return BUTTON_STATE_NOT_PRESSED;
-    }
-
-    // Rising edge
-    if (button->lastPressState != button->expectedSignalWhenPressed)
-    {
-        button->lastPressState = button->expectedSignalWhenPressed;
-        button->lastPressedTime = now;
-        return BUTTON_STATE_PRESSED;
-    }
-
-    // Held
-    const uint8_t BUTTON_HOLD_TIME_MS = 2;
-    if ((now - button->lastPressedTime) >= BUTTON_HOLD_TIME_MS)
-    {
-        return BUTTON_STATE_HELD;
-    }
-
-    return BUTTON_STATE_NOT_PRESSED;
+	if (ButtonBank_TakePressed(button->bank, button->gpioPin))
+	{
+		return BUTTON_STATE_PRESSED;
+	}
+	if (ButtonBank_GetHeld(button->bank) & button->gpioPin)
+	{
+		return BUTTON_STATE_HELD;
+	}
+	return BUTTON_STATE_NOT_PRESSED;
 }
@@ -7,10 +7,130 @@
 
 #include "lcd_HD44780U.h"
 #include "display_control.h"
+#include "lcd_glyph_cache.h"
+#include "lcd_framebuffer.h"
+#include "lcd_marquee.h"
+#include "field_format.h"
 #include "stm32f1xx_hal.h"
-#include <stdio.h>
+#include <string.h>
 
 static uint8_t current_page = 1;
+static uint8_t requestedPage = 0; //Page to switch to in the next DisplayTime() call, 0 if none
+
+//IDs of the custom characters registered in the glyph cache
+enum
+{
+	GLYPH_BELL = 0,
+	//Segments of the big digits, rounded corners and bars
+	GLYPH_SEGMENT_LEFT_TOP,
+	GLYPH_SEGMENT_UPPER_BAR,
+	GLYPH_SEGMENT_RIGHT_TOP,
+	GLYPH_SEGMENT_LEFT_LOW,
+	GLYPH_SEGMENT_LOWER_BAR,
+	GLYPH_SEGMENT_RIGHT_LOW,
+	GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS,
+	GLYPH_SEGMENT_COUNT = GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS, //The bell is the 8th glyph, CGRAM has room for all
+};
+
+static const uint8_t bellGlyph[8] =
+{
+	0b00100,
+	0b01110,
+	0b01110,
+	0b01110,
+	0b11111,
+	0b00000,
+	0b00100,
+	0b00000,
+};
+
+static const uint8_t segmentGlyphs[GLYPH_SEGMENT_COUNT][8] =
+{
+	{ 0b00111, 0b01111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111 }, //Left top
+	{ 0b11111, 0b11111, 0b11111, 0b00000, 0b00000, 0b00000, 0b00000, 0b00000 }, //Upper bar
+	{ 0b11100, 0b11110, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111 }, //Right top
+	{ 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b01111, 0b00111 }, //Left low
+	{ 0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b11111, 0b11111, 0b11111 }, //Lower bar
+	{ 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11110, 0b11100 }, //Right low
+	{ 0b11111, 0b11111, 0b11111, 0b00000, 0b00000, 0b00000, 0b11111, 0b11111 }, //Upper and middle bars
+};
+
+//Cells of the big digits that aren't glyphs. Both are characters from the ROM of the chip.
+#define BIG_DIGIT_BLANK		' '
+#define BIG_DIGIT_FULL		0xFF
+#define BIG_DIGIT_COLON		0xA5 //A dot character for this particular LCD.
+
+//Each digit is 3 columns wide, the top row comes first. Values are glyph IDs unless they are BLANK or FULL.
+static const uint8_t bigDigits[10][6] =
+{
+	{ GLYPH_SEGMENT_LEFT_TOP, GLYPH_SEGMENT_UPPER_BAR, GLYPH_SEGMENT_RIGHT_TOP,
+	  GLYPH_SEGMENT_LEFT_LOW, GLYPH_SEGMENT_LOWER_BAR, GLYPH_SEGMENT_RIGHT_LOW }, //0
+	{ GLYPH_SEGMENT_UPPER_BAR, GLYPH_SEGMENT_RIGHT_TOP, BIG_DIGIT_BLANK,
+	  GLYPH_SEGMENT_LOWER_BAR, BIG_DIGIT_FULL, GLYPH_SEGMENT_LOWER_BAR }, //1
+	{ GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS, GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS, GLYPH_SEGMENT_RIGHT_TOP,
+	  GLYPH_SEGMENT_LEFT_LOW, GLYPH_SEGMENT_LOWER_BAR, GLYPH_SEGMENT_LOWER_BAR }, //2
+	{ GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS, GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS, GLYPH_SEGMENT_RIGHT_TOP,
+	  GLYPH_SEGMENT_LOWER_BAR, GLYPH_SEGMENT_LOWER_BAR, GLYPH_SEGMENT_RIGHT_LOW }, //3
+	{ GLYPH_SEGMENT_LEFT_LOW, GLYPH_SEGMENT_LOWER_BAR, BIG_DIGIT_FULL,
+	  BIG_DIGIT_BLANK, BIG_DIGIT_BLANK, BIG_DIGIT_FULL }, //4
+	{ GLYPH_SEGMENT_LEFT_LOW, GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS, GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS,
+	  GLYPH_SEGMENT_LOWER_BAR, GLYPH_SEGMENT_LOWER_BAR, GLYPH_SEGMENT_RIGHT_LOW }, //5
+	{ GLYPH_SEGMENT_LEFT_TOP, GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS, GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS,
+	  GLYPH_SEGMENT_LEFT_LOW, GLYPH_SEGMENT_LOWER_BAR, GLYPH_SEGMENT_RIGHT_LOW }, //6
+	{ GLYPH_SEGMENT_UPPER_BAR, GLYPH_SEGMENT_UPPER_BAR, GLYPH_SEGMENT_RIGHT_TOP,
+	  BIG_DIGIT_BLANK, BIG_DIGIT_BLANK, BIG_DIGIT_FULL }, //7
+	{ GLYPH_SEGMENT_LEFT_TOP, GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS, GLYPH_SEGMENT_RIGHT_TOP,
+	  GLYPH_SEGMENT_LEFT_LOW, GLYPH_SEGMENT_LOWER_BAR, GLYPH_SEGMENT_RIGHT_LOW }, //8
+	{ GLYPH_SEGMENT_LEFT_TOP, GLYPH_SEGMENT_UPPER_AND_MIDDLE_BARS, GLYPH_SEGMENT_RIGHT_TOP,
+	  BIG_DIGIT_BLANK, BIG_DIGIT_BLANK, BIG_DIGIT_FULL }, //9
+};
+
+
+//Starting columns of the big digits (HH:MM) and the colon. The last column shows AM/PM as A/P over M.
+static const uint8_t bigDigitColumns[4] = { 1, 5, 9, 13 };
+#define BIG_COLON_COLUMN	8
+#define BIG_SUFFIX_COLUMN	16
+
+//Copy of the last displayed info, pages are rendered from this.
+static DisplayInfo lastDisplayedInfo;
+static uint8_t hasDisplayedInfo = 0;
+static uint32_t lastRenderTick = 0;
+
+static Marquee dateMarquee = { 0 };
+static uint8_t marqueeStepped = 0; //Set by the render function of a page when a marquee on it moved.
+
+static void RegisterGlyphs(void)
+{
+	static uint8_t registered = 0;
+	if (!registered)
+	{
+		Glyph_Register(GLYPH_BELL, bellGlyph);
+		for (int i = 0; i < GLYPH_SEGMENT_COUNT; i++)
+		{
+			Glyph_Register(GLYPH_SEGMENT_LEFT_TOP + i, segmentGlyphs[i]);
+		}
+		registered = 1;
+	}
+}
+
+//Returns the character to write for a cell of a big digit.
+static uint8_t GetBigDigitCell(uint8_t cell)
+{
+	if (cell == BIG_DIGIT_BLANK || cell == BIG_DIGIT_FULL)
+	{
+		return cell;
+	}
+	return Glyph_Acquire(cell);
+}
+
+static void DrawBigDigit(uint8_t column, uint8_t digit)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		Framebuffer_WriteCharacter(1, column + i, GetBigDigitCell(bigDigits[digit][i]));
+		Framebuffer_WriteCharacter(2, column + i, GetBigDigitCell(bigDigits[digit][i + 3]));
+	}
+}
 
 static const char* GetDayName(uint8_t dayOfWeek)
 {
@@ -40,50 +160,464 @@ static const char* GetMonthName(uint8_t month)
 	return months[month - 1];
 }
 
-static float ConvertTemperatureToFloat(uint16_t temp, uint8_t unit)
-{
-	int8_t integerPortion = (temp & 0xFF00) >> 8;
-	uint8_t fractalPortion = (temp & 0x00FF) >> 6; //upper 2 bits of the last 8 bits are used, details are in the datasheet
-	float temperature = (float)integerPortion;
-	switch (fractalPortion)
-	{
-	case 0b00:
-		temperature += 0.00f;
-		break;
-	case 0b01:
-		temperature += 0.25f;
-		break;
-	case 0b10:
-		temperature += 0.50f;
-		break;
-	case 0b11:
-		temperature += 0.75f;
-		break;
-	default:
-		//Do nothing, we should never hit here.
-		break;
-	}
-	//At this point, temperature is calculated in terms of celsius.
-	//Now convert if necessary.
-	switch (unit)
-	{
-	case TEMP_UNIT_CELSIUS:
-		//Already celsius, don't do anything.
-		break;
-	case TEMP_UNIT_FAHRENHEIT:
-		temperature *= 1.8f;
-		temperature += 32;
-		break;
-	case TEMP_UNIT_KELVIN:
-		temperature += 273.5;
-		break;
-	default:
-		//Unknown unit, simply leave it as celsius.
-		break;
-	}
-	return temperature;
+/*
+  Each unit is a linear function of the raw temperature, which counts quarter degrees celsius. Both the scale
+  and the offset are whole hundredths of a degree, so the conversion is exact in integers:
+  1/4 C = 25 hundredths of C or K and 45 hundredths of F.
+*/
+typedef struct TemperatureUnit
+{
+	const char* name;
+	int16_t centiPerQuarter;
+	int32_t centiOffset;
+} TemperatureUnit;
+
+static const TemperatureUnit temperatureUnits[] =
+{
+	[TEMP_UNIT_CELSIUS] = { "Cel", 25, 0 },
+	[TEMP_UNIT_FAHRENHEIT] = { "Fah", 45, 3200 },
+	[TEMP_UNIT_KELVIN] = { "Kel", 25, 27315 },
+};
+
+//Unknown units are displayed as celsius without a unit name.
+static const TemperatureUnit unknownTemperatureUnit = { "", 25, 0 };
+
+static const TemperatureUnit* GetTemperatureUnit(uint8_t unit)
+{
+	return unit < arr_size(temperatureUnits) ? &temperatureUnits[unit] : &unknownTemperatureUnit;
+}
+
+//Converts the raw DS3231 temperature into hundredths of a degree of the given unit.
+static int32_t ConvertTemperatureToCenti(uint16_t temp, uint8_t unit)
+{
+	//The upper 10 bits are a two's complement number of quarter degrees, details are in the datasheet.
+	int32_t quarters = (int16_t)(temp & 0xFFC0) / 64;
+	const TemperatureUnit* temperatureUnit = GetTemperatureUnit(unit);
+	return quarters * temperatureUnit->centiPerQuarter + temperatureUnit->centiOffset;
+}
+
+//Writes the characters formatted into text, end is what the last Format_ call returned.
+static void WriteLine(uint8_t line, uint8_t column, const char* text, const char* end)
+{
+	Framebuffer_Write(line, column, text, end - text);
+}
+
+//Every line is formatted with fixed widths that fit on the screen, the buffers don't need a null terminator.
+#define MAX_CHARS_ON_A_LINE		FRAMEBUFFER_COLUMNS
+
+//The hours of the day in 12h format. The DS3231 always counts in 24h, the format is only applied when rendering.
+static const uint8_t hoursIn12hFormat[24] =
+{
+	12, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+	12, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+};
+
+//Converts the hours of the day (00-23) into the given display format.
+static uint8_t GetDisplayedHours(uint8_t displayFormat, uint8_t hours)
+{
+	return displayFormat == DISPLAY_FORMAT_12H ? hoursIn12hFormat[hours % 24] : hours;
+}
+
+static const char* GetTimeSuffix(uint8_t displayFormat, uint8_t hours)
+{
+	return displayFormat == DISPLAY_FORMAT_12H ? (hours >= 12 ? "PM" : "AM") : "  ";
+}
+
+//HH:MM:SS
+static char* FormatClock(char* out, const DisplayInfo* info)
+{
+	out = Format_Time(out, GetDisplayedHours(info->displayFormat, info->hours), info->minutes);
+	*out++ = ':';
+	return Format_TwoDigits(out, info->seconds);
+}
+
+/*
+  Pages made of fields. Each field is a fixed region of the page that only depends on some of the info, given by
+  the DISPLAY_FIELD_ bits. When the info changes, only the fields it affects are formatted again.
+*/
+typedef struct DisplayField
+{
+	uint8_t changedBy; //DISPLAY_FIELD_ bits the field depends on, 0 for fixed text.
+	uint8_t line;
+	uint8_t column;
+	uint8_t width; //What the format leaves out is cleared.
+	char* (*format)(char* out, const DisplayInfo* info); //NULL for fixed text.
+	const char* text;
+} DisplayField;
+
+static char* FormatHoursField(char* out, const DisplayInfo* info)
+{
+	return Format_TwoDigits(out, GetDisplayedHours(info->displayFormat, info->hours));
+}
+
+static char* FormatMinutesField(char* out, const DisplayInfo* info)
+{
+	return Format_TwoDigits(out, info->minutes);
 }
 
+static char* FormatSecondsField(char* out, const DisplayInfo* info)
+{
+	return Format_TwoDigits(out, info->seconds);
+}
+
+static char* FormatTimeSuffixField(char* out, const DisplayInfo* info)
+{
+	return Format_Text(out, GetTimeSuffix(info->displayFormat, info->hours));
+}
+
+//DD Mon YYYY
+static char* FormatDateField(char* out, const DisplayInfo* info)
+{
+	out = Format_TwoDigits(out, info->dayOfTheMonth);
+	*out++ = ' ';
+	out = Format_Text(out, GetMonthName(info->month));
+	*out++ = ' ';
+	return Format_FourDigits(out, info->year);
+}
+
+static char* FormatWeekdayField(char* out, const DisplayInfo* info)
+{
+	return Format_Text(out, GetDayName(info->dayOfTheWeek));
+}
+
+//HH:MM XX
+static char* FormatAlarmTimeField(char* out, const DisplayInfo* info)
+{
+	out = Format_Time(out, GetDisplayedHours(info->displayFormat, info->alarmHours), info->alarmMinutes);
+	*out++ = ' ';
+	return Format_Text(out, GetTimeSuffix(info->displayFormat, info->alarmHours));
+}
+
+static char* FormatAlarmBellField(char* out, const DisplayInfo* info)
+{
+	*out++ = info->alarmEnabled == ALARM_ENABLED ? Glyph_Acquire(GLYPH_BELL) : ' ';
+	return out;
+}
+
+//The temperature with its unit, at most 11 characters wide.
+static char* FormatTemperatureField(char* out, const DisplayInfo* info)
+{
+	out = Format_Centi(out, ConvertTemperatureToCenti(info->temperature, info->tempUnit));
+	*out++ = ' '; //The space before the unit is intentional, it's not a typo
+	return Format_Text(out, GetTemperatureUnit(info->tempUnit)->name);
+}
+
+//The hours also change with the format, AM/PM is part of them.
+#define HOURS_CHANGED_BY	(DISPLAY_FIELD_HOURS | DISPLAY_FIELD_FORMAT)
+#define ALARM_CHANGED_BY	(DISPLAY_FIELD_ALARM | DISPLAY_FIELD_FORMAT)
+
+#if DISPLAY_USE_OVERVIEW_PAGE
+//Time and date at the same positions as on the time page of 2 row panels, so editing looks the same.
+static const DisplayField overviewPageFields[] =
+{
+	{ HOURS_CHANGED_BY, 1, 1, 2, FormatHoursField, NULL },
+	{ 0, 1, 3, 1, NULL, ":" },
+	{ DISPLAY_FIELD_MINUTES, 1, 4, 2, FormatMinutesField, NULL },
+	{ 0, 1, 6, 1, NULL, ":" },
+	{ DISPLAY_FIELD_SECONDS, 1, 7, 2, FormatSecondsField, NULL },
+	{ HOURS_CHANGED_BY, 1, 10, 2, FormatTimeSuffixField, NULL },
+	{ DISPLAY_FIELD_DATE, 2, 1, 11, FormatDateField, NULL },
+	{ DISPLAY_FIELD_WEEKDAY, 2, 14, 3, FormatWeekdayField, NULL },
+	{ 0, 3, 1, 6, NULL, "Alarm " },
+	{ ALARM_CHANGED_BY, 3, 7, 8, FormatAlarmTimeField, NULL },
+	{ DISPLAY_FIELD_ALARM, 3, FRAMEBUFFER_COLUMNS, 1, FormatAlarmBellField, NULL },
+	{ 0, 4, 1, 4, NULL, "Temp" },
+	{ DISPLAY_FIELD_TEMPERATURE | DISPLAY_FIELD_FORMAT, 4, 8, 11, FormatTemperatureField, NULL },
+};
+#else
+static const DisplayField timePageFields[] =
+{
+	{ HOURS_CHANGED_BY, 1, 1, 2, FormatHoursField, NULL },
+	{ 0, 1, 3, 1, NULL, ":" },
+	{ DISPLAY_FIELD_MINUTES, 1, 4, 2, FormatMinutesField, NULL },
+	{ 0, 1, 6, 1, NULL, ":" },
+	{ DISPLAY_FIELD_SECONDS, 1, 7, 2, FormatSecondsField, NULL },
+	{ HOURS_CHANGED_BY, 1, 10, 2, FormatTimeSuffixField, NULL },
+	{ 0, 1, 16, 1, NULL, ">" },
+	{ DISPLAY_FIELD_DATE, 2, 1, 11, FormatDateField, NULL },
+	{ DISPLAY_FIELD_WEEKDAY, 2, 14, 3, FormatWeekdayField, NULL },
+};
+
+//The alarm time is one column further right in 24h format, where it has no suffix.
+static char* FormatAlarmLineField(char* out, const DisplayInfo* info)
+{
+	out = Format_Fill(out, ' ', info->displayFormat == DISPLAY_FORMAT_12H ? 3 : 4);
+	return FormatAlarmTimeField(out, info);
+}
+
+static const DisplayField alarmPageFields[] =
+{
+	{ 0, 1, 1, 1, NULL, "<" },
+	{ ALARM_CHANGED_BY, 1, 2, 12, FormatAlarmLineField, NULL },
+	{ DISPLAY_FIELD_ALARM, 1, 16, 1, FormatAlarmBellField, NULL },
+	{ DISPLAY_FIELD_TEMPERATURE | DISPLAY_FIELD_FORMAT, 2, 4, 11, FormatTemperatureField, NULL },
+};
+#endif
+
+//Formats a field into the framebuffer, padded with spaces to its width. Returns the width.
+static uint8_t RenderField(const DisplayField* field, const DisplayInfo* info)
+{
+	char text[MAX_CHARS_ON_A_LINE];
+	char* end = field->format != NULL ? field->format(text, info) : Format_Text(text, field->text);
+	if (end - text < field->width)
+	{
+		end = Format_Fill(end, ' ', field->width - (end - text));
+	}
+	WriteLine(field->line, field->column, text, end);
+	return field->width;
+}
+
+//HH:MM in two line tall digits. Unchanged digits are the same in the framebuffer, so only the changes get written.
+static void RenderBigClockPage(const DisplayInfo* info)
+{
+	uint8_t hours = GetDisplayedHours(info->displayFormat, info->hours);
+	uint8_t digits[4] = { hours / 10, hours % 10, info->minutes / 10, info->minutes % 10 };
+	for (int i = 0; i < 4; i++)
+	{
+		DrawBigDigit(bigDigitColumns[i], digits[i] % 10);
+	}
+
+	uint8_t colon = (info->seconds % 2 == 0) ? BIG_DIGIT_COLON : BIG_DIGIT_BLANK; //Blinks once every 2 seconds
+	Framebuffer_WriteCharacter(1, BIG_COLON_COLUMN, colon);
+	Framebuffer_WriteCharacter(2, BIG_COLON_COLUMN, colon);
+
+	if (info->displayFormat == DISPLAY_FORMAT_12H)
+	{
+		Framebuffer_WriteCharacter(1, BIG_SUFFIX_COLUMN, GetTimeSuffix(info->displayFormat, info->hours)[0]);
+		Framebuffer_WriteCharacter(2, BIG_SUFFIX_COLUMN, 'M');
+	}
+}
+
+static DisplayDiagnostics shownDiagnostics = { 0 };
+
+static void RenderDiagnosticsPage(const DisplayInfo* info)
+{
+	char line[MAX_CHARS_ON_A_LINE];
+	//Load 12.34% Tx 4
+	char* end = Format_Unsigned(Format_Text(line, "Load"), shownDiagnostics.cpuLoadHundredths / 100, 3);
+	*end++ = '.';
+	end = Format_TwoDigits(end, shownDiagnostics.cpuLoadHundredths);
+	end = Format_Unsigned(Format_Text(end, "% Tx"), shownDiagnostics.lastCommitTransactions, 2);
+	WriteLine(1, 1, line, end);
+	//Edit  850us Ch 2, the last increment in edit mode
+	uint32_t editUs = shownDiagnostics.lastEditCycles / (HAL_RCC_GetHCLKFreq() / 1000000);
+	end = Format_Unsigned(Format_Text(line, "Edit"), editUs, 5);
+	end = Format_Unsigned(Format_Text(end, "us Ch"), shownDiagnostics.lastEditCharacters, 2);
+	WriteLine(2, 1, line, end);
+}
+
+static void RenderDatePage(const DisplayInfo* info)
+{
+	static const char* days[] = { "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday", "Sunday" };
+	static const char* months[] = { "January", "February", "March", "April", "May", "June", "July", "August",
+									"September", "October", "November", "December" };
+	uint8_t day = (info->dayOfTheWeek >= 1 && info->dayOfTheWeek <= 7) ? info->dayOfTheWeek : 1;
+	uint8_t month = (info->month >= 1 && info->month <= 12) ? info->month : 1;
+
+	char line[MAX_CHARS_ON_A_LINE];
+	WriteLine(1, 1, line, FormatClock(Format_Text(line, "Date    "), info));
+
+	//The longest date is 29 characters, it fits in a marquee.
+	char date[MARQUEE_MAX_LENGTH + 1];
+	char* end = Format_Text(Format_Text(date, days[day - 1]), ", ");
+	end = Format_Unsigned(end, info->dayOfTheMonth, 0);
+	*end++ = ' ';
+	end = Format_Text(end, months[month - 1]);
+	*end++ = ' ';
+	end = Format_FourDigits(end, info->year);
+	*end = '\0';
+	Marquee_SetText(&dateMarquee, date);
+	marqueeStepped |= Marquee_RenderWindow(&dateMarquee, 2, 1, FRAMEBUFFER_COLUMNS);
+}
+
+typedef struct DisplayPage
+{
+	void (*render)(const DisplayInfo* info); //Renders the page into the framebuffer, which is cleared beforehand.
+	const DisplayField* fields; //Used instead of render if it is NULL
+	uint8_t fieldCount;
+	uint16_t refreshPeriodMs; //The page is rendered at least this often, and whenever the info changes.
+	uint8_t preRenderNextSecond; //Whether the page depends on the seconds and is flipped in at the second boundary.
+	uint8_t sources; //DISPLAY_SOURCE_ bits of the info the page is rendered from
+} DisplayPage;
+
+//In the order of the page numbers.
+static const DisplayPage pages[DISPLAY_PAGE_COUNT] =
+{
+#if DISPLAY_USE_OVERVIEW_PAGE
+	{ NULL, overviewPageFields, arr_size(overviewPageFields), 1000, 1, DISPLAY_SOURCE_ALL },
+#else
+	{ NULL, timePageFields, arr_size(timePageFields), 1000, 1, DISPLAY_SOURCE_TIME | DISPLAY_SOURCE_DATE },
+	{ NULL, alarmPageFields, arr_size(alarmPageFields), 1000, 0, DISPLAY_SOURCE_ALARM | DISPLAY_SOURCE_TEMPERATURE },
+#endif
+	{ RenderBigClockPage, NULL, 0, 1000, 1, DISPLAY_SOURCE_TIME },
+	{ RenderDiagnosticsPage, NULL, 0, 500, 0, 0 },
+	{ RenderDatePage, NULL, 0, MARQUEE_STEP_PERIOD_MS, 0, DISPLAY_SOURCE_TIME | DISPLAY_SOURCE_DATE },
+};
+
+//Set from the SQW interrupt, the DWT and tick counts of the last second boundary.
+static volatile uint8_t secondBoundaryPending = 0;
+static volatile uint32_t secondBoundaryCycle = 0;
+static volatile uint32_t secondBoundaryTick = 0;
+static uint32_t readBoundaryTick = 0; //The second boundary ShouldReadDisplayInfo() last returned
+static DisplayFlipStats flipStats = { 0 };
+static DisplayRenderStats renderStats = { 0 };
+
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING
+//The info the hidden bank was rendered with.
+static DisplayInfo preRenderedInfo;
+static uint8_t hasPreRenderedFrame = 0;
+static uint8_t preRenderAttempted = 0; //Pre-rendering is tried once for each displayed info.
+#endif
+
+//The info the framebuffer currently holds the current page for. Fields are rendered again when it changes.
+static DisplayInfo frameInfo;
+static uint8_t frameIsValid = 0;
+
+/*
+  Renders info into the framebuffer. Pages made of fields only get the fields that differ from the framebuffer,
+  other pages are rendered from scratch.
+*/
+static void RenderPage(const DisplayInfo* info)
+{
+	const DisplayPage* page = &pages[current_page - 1];
+	uint8_t changedFields = frameIsValid ? GetChangedDisplayFields(&frameInfo, info) : DISPLAY_FIELD_ALL;
+	uint32_t renderedCharacters = 0;
+	if (page->render != NULL || changedFields == DISPLAY_FIELD_ALL)
+	{
+		Framebuffer_Clear();
+	}
+	if (page->render != NULL)
+	{
+		page->render(info);
+		renderedCharacters = FRAMEBUFFER_LINES * FRAMEBUFFER_COLUMNS;
+	}
+	else
+	{
+		for (int i = 0; i < page->fieldCount; i++)
+		{
+			const DisplayField* field = &page->fields[i];
+			//Fixed text only needs to be rendered after a clear.
+			if (changedFields == DISPLAY_FIELD_ALL || (field->changedBy & changedFields) != 0)
+			{
+				renderedCharacters += RenderField(field, info);
+			}
+		}
+	}
+	renderStats.lastRenderedCharacters = renderedCharacters;
+	//memcpy so that the padding is copied as well and memcmp works.
+	memcpy(&frameInfo, info, sizeof(DisplayInfo));
+	frameIsValid = 1;
+}
+
+//Renders the current page from the last displayed info and writes the changes to the screen. Returns the number
+//of characters written.
+static uint32_t RenderCurrentPage(void)
+{
+	RegisterGlyphs();
+	uint32_t start = DWT->CYCCNT;
+	marqueeStepped = 0;
+	RenderPage(&lastDisplayedInfo);
+	uint32_t renderCycles = DWT->CYCCNT - start;
+	renderStats.renders++;
+	renderStats.lastRenderCycles = renderCycles;
+	if (renderCycles > renderStats.maxRenderCycles)
+	{
+		renderStats.maxRenderCycles = renderCycles;
+	}
+	uint32_t written = Framebuffer_Flush();
+	if (marqueeStepped)
+	{
+		Marquee_RecordWindowStep(DWT->CYCCNT - start, written);
+	}
+	lastRenderTick = HAL_GetTick();
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING
+	hasPreRenderedFrame = 0;
+	preRenderAttempted = 0;
+#endif
+	return written;
+}
+
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING
+//Moves the time of info one second forward. Returns 0 if the date would change, that isn't predicted.
+static uint8_t AdvanceOneSecond(DisplayInfo* info)
+{
+	if (++info->seconds < 60)
+	{
+		return 1;
+	}
+	info->seconds = 0;
+	if (++info->minutes < 60)
+	{
+		return 1;
+	}
+	info->minutes = 0;
+	if (++info->hours < 24)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+//Renders what the current page will show one second later into the hidden bank.
+static void PreRenderNextSecond(void)
+{
+	preRenderAttempted = 1;
+	hasPreRenderedFrame = 0;
+	if (!pages[current_page - 1].preRenderNextSecond)
+	{
+		return;
+	}
+	memcpy(&preRenderedInfo, &lastDisplayedInfo, sizeof(DisplayInfo));
+	if (!AdvanceOneSecond(&preRenderedInfo))
+	{
+		return;
+	}
+	RenderPage(&preRenderedInfo);
+	Framebuffer_FlushHidden();
+	hasPreRenderedFrame = 1;
+}
+
+//Flips to the pre-rendered frame if a second boundary has just passed. Returns 1 if it flipped.
+static uint8_t FlipAtSecondBoundary(const DisplayInfo* info)
+{
+	if (!secondBoundaryPending)
+	{
+		return 0;
+	}
+	secondBoundaryPending = 0;
+	if (!hasPreRenderedFrame)
+	{
+		return 0;
+	}
+	hasPreRenderedFrame = 0;
+
+	//The frame is only right if nothing but the time changed since it was rendered. Edited values for example
+	//make it wrong. info is either still the old second or already the new one, depending on when it was read.
+	uint8_t isOnTime = (HAL_GetTick() - secondBoundaryTick) <= DISPLAY_FLIP_MAX_LATENCY_MS;
+	uint8_t isInfoExpected = memcmp(info, &lastDisplayedInfo, sizeof(DisplayInfo)) == 0 ||
+							 memcmp(info, &preRenderedInfo, sizeof(DisplayInfo)) == 0;
+	if (!isOnTime || !isInfoExpected)
+	{
+		flipStats.discardedFrames++;
+		return 0;
+	}
+
+	Framebuffer_Flip();
+	uint32_t jitter = DWT->CYCCNT - secondBoundaryCycle;
+	flipStats.flips++;
+	flipStats.lastJitterCycles = jitter;
+	if (jitter > flipStats.maxJitterCycles)
+	{
+		flipStats.maxJitterCycles = jitter;
+	}
+
+	memcpy(&lastDisplayedInfo, &preRenderedInfo, sizeof(DisplayInfo));
+	lastRenderTick = HAL_GetTick();
+	preRenderAttempted = 0;
+	return 1;
+}
+#endif
+
 void DisplayTime(DisplayInfo* info)
 {
 	if (info == NULL)
@@ -91,65 +625,166 @@ void DisplayTime(DisplayInfo* info)
 		return;
 	}
 
-	//Positions 1-16 are page 1 and 17-32 are page 2.
+	if (requestedPage != 0)
+	{
+		//info was read for the requested page as well, so it can be drawn right away.
+		uint8_t page = requestedPage;
+		requestedPage = 0;
+		memcpy(&lastDisplayedInfo, info, sizeof(DisplayInfo));
+		hasDisplayedInfo = 1;
+		SwitchToPage(page);
+		return;
+	}
 
-	info->alarmDisplayFormat = info->displayFormat;
+	uint8_t infoChanged = !hasDisplayedInfo || memcmp(info, &lastDisplayedInfo, sizeof(DisplayInfo)) != 0;
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING
+	if (FlipAtSecondBoundary(info))
+	{
+		return;
+	}
+#endif
+	if (!infoChanged && (HAL_GetTick() - lastRenderTick) < pages[current_page - 1].refreshPeriodMs)
+	{
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING
+		//Prepare the next second while there is nothing else to draw.
+		if (!preRenderAttempted)
+		{
+			PreRenderNextSecond();
+		}
+#endif
+		return;
+	}
+	//memcpy instead of an assignment so that the padding is copied as well and memcmp works.
+	memcpy(&lastDisplayedInfo, info, sizeof(DisplayInfo));
+	hasDisplayedInfo = 1;
+	RenderCurrentPage();
+}
 
-	//PAGE 1
-	MoveCursor(1, 1);
-	static const uint8_t MAX_CHARS_ON_A_LINE = 17; //16 + 1 to account for the null character since we are using snprintf
-	char line[MAX_CHARS_ON_A_LINE];
-	snprintf(line, MAX_CHARS_ON_A_LINE, "%02d:%02d:%02d %s    >", info->hours, info->minutes, info->seconds, info->displayFormat == DISPLAY_FORMAT_12H ? (info->isTimePM ? "PM" : "AM") : "  ");
-	WriteString(line);
-	MoveCursor(2, 1);
+uint32_t DisplayEditedInfo(const DisplayInfo* info)
+{
+	if (info == NULL)
+	{
+		return 0;
+	}
+	memcpy(&lastDisplayedInfo, info, sizeof(DisplayInfo));
+	hasDisplayedInfo = 1;
+	return RenderCurrentPage();
+}
 
-	snprintf(line, MAX_CHARS_ON_A_LINE, "%02d %s %04d  %s", info->dayOfTheMonth, GetMonthName(info->month), info->year, GetDayName(info->dayOfTheWeek));
-	WriteString(line);
+uint8_t FlipToNextSecond(const DisplayInfo* info)
+{
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING
+	//A pending toggle switches the page in the next DisplayTime(), the frame is of the old page.
+	if (info != NULL && requestedPage == 0)
+	{
+		return FlipAtSecondBoundary(info);
+	}
+#endif
+	return 0;
+}
 
-	//PAGE 2
-	MoveCursor(1, 17);
-	snprintf(line, MAX_CHARS_ON_A_LINE, "<%s%02d:%02d%s", info->alarmDisplayFormat == DISPLAY_FORMAT_12H ? "   " : "    ",
-														  info->alarmHours,
-														  info->alarmMinutes,
-														  info->alarmDisplayFormat == DISPLAY_FORMAT_12H ? ((info->isAlarmTimePM ? " PM" : " AM")) : "   ");
+void SignalSecondBoundary(void)
+{
+	secondBoundaryCycle = DWT->CYCCNT;
+	secondBoundaryTick = HAL_GetTick();
+	secondBoundaryPending = 1;
+}
 
-	WriteString(line);
-	if (info->alarmEnabled == ALARM_ENABLED)
+uint8_t ShouldReadDisplayInfo(void)
+{
+	if (!hasDisplayedInfo || requestedPage != 0)
 	{
-		MoveCursor(1, 32);
-		SendByte(0xA5); //A dot character for this particular LCD.
+		return 1;
 	}
-	else
+	uint32_t boundaryTick = secondBoundaryTick;
+	if (boundaryTick != readBoundaryTick)
 	{
-		MoveCursor(1, 32);
-		WriteCharacter(' '); //Clear the dot if the alarm is not enabled.
+		readBoundaryTick = boundaryTick;
+		return 1;
 	}
+	return (HAL_GetTick() - boundaryTick) >= 1000 + DISPLAY_SQW_TOLERANCE_MS;
+}
 
-	MoveCursor(2, 17);
-	float temperature = ConvertTemperatureToFloat(info->temperature, info->tempUnit);
+uint32_t GetDisplayIdleMs(void)
+{
+	if (!hasDisplayedInfo || requestedPage != 0 || secondBoundaryTick != readBoundaryTick)
+	{
+		return 0;
+	}
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING
+	//The next second is pre-rendered in the pass right after the display changed.
+	if (!preRenderAttempted && pages[current_page - 1].preRenderNextSecond)
+	{
+		return 0;
+	}
+#endif
+	uint32_t now = HAL_GetTick();
+	uint32_t sinceBoundary = now - secondBoundaryTick;
+	uint32_t sinceRender = now - lastRenderTick;
+	uint32_t refreshPeriod = pages[current_page - 1].refreshPeriodMs;
+	if (sinceBoundary >= 1000 + DISPLAY_SQW_TOLERANCE_MS || sinceRender >= refreshPeriod)
+	{
+		return 0;
+	}
+	//Until the page has to be refreshed, or the SQW signal counts as missing and the time has to be polled.
+	uint32_t untilRefresh = refreshPeriod - sinceRender;
+	uint32_t untilSQWMissing = 1000 + DISPLAY_SQW_TOLERANCE_MS - sinceBoundary;
+	return untilRefresh < untilSQWMissing ? untilRefresh : untilSQWMissing;
+}
 
-	//The space at the end of the string is intentional, it's not a typo
-	snprintf(line, MAX_CHARS_ON_A_LINE, "   %s%02d.%02d ",
-			temperature < 0 ? "" : "+",
-			(int)temperature,
-			(int)((temperature - (int)temperature) * 100));
-	WriteString(line);
+const DisplayFlipStats* GetDisplayFlipStats(void)
+{
+	return &flipStats;
+}
 
-	switch (info->tempUnit)
+uint8_t GetChangedDisplayFields(const DisplayInfo* previous, const DisplayInfo* current)
+{
+	uint8_t changed = 0;
+	if (previous->seconds != current->seconds)
+	{
+		changed |= DISPLAY_FIELD_SECONDS;
+	}
+	if (previous->minutes != current->minutes)
 	{
-	case TEMP_UNIT_CELSIUS:
-		WriteString("Cel");
-		break;
-	case TEMP_UNIT_FAHRENHEIT:
-		WriteString("Fah");
-		break;
-	case TEMP_UNIT_KELVIN:
-		WriteString("Kel");
-		break;
-	default:
-		//If the value isn't specified don't display any unit
-		break;
+		changed |= DISPLAY_FIELD_MINUTES;
 	}
+	if (previous->hours != current->hours)
+	{
+		changed |= DISPLAY_FIELD_HOURS;
+	}
+	if (previous->dayOfTheMonth != current->dayOfTheMonth || previous->month != current->month ||
+		previous->year != current->year)
+	{
+		changed |= DISPLAY_FIELD_DATE;
+	}
+	if (previous->dayOfTheWeek != current->dayOfTheWeek)
+	{
+		changed |= DISPLAY_FIELD_WEEKDAY;
+	}
+	if (previous->alarmHours != current->alarmHours || previous->alarmMinutes != current->alarmMinutes ||
+		previous->alarmEnabled != current->alarmEnabled)
+	{
+		changed |= DISPLAY_FIELD_ALARM;
+	}
+	if (previous->temperature != current->temperature)
+	{
+		changed |= DISPLAY_FIELD_TEMPERATURE;
+	}
+	if (previous->displayFormat != current->displayFormat || previous->tempUnit != current->tempUnit)
+	{
+		changed |= DISPLAY_FIELD_FORMAT;
+	}
+	return changed;
+}
+
+const DisplayRenderStats* GetDisplayRenderStats(void)
+{
+	return &renderStats;
+}
+
+void SetDisplayDiagnostics(const DisplayDiagnostics* diagnostics)
+{
+	memcpy(&shownDiagnostics, diagnostics, sizeof(DisplayDiagnostics));
 }
 
 void SwitchToPage(uint8_t page)
@@ -158,31 +793,29 @@ void SwitchToPage(uint8_t page)
 	{
 		page = 1;
 	}
-	else if (page > 2)
+	else if (page > DISPLAY_PAGE_COUNT)
 	{
-		page = 2;
+		page = DISPLAY_PAGE_COUNT;
 	}
 
+	requestedPage = 0; //An explicit switch overrides a pending toggle
 	if (page == current_page)
 	{
 		return;
 	}
 
-	if (page == 1) //Currently on page 2, switch to page 1
-	{
-		ShiftDisplayRight(16);
-	}
-	else if (page == 2) //Currently on page 1, switch to page 2
+	//Every page is drawn on the same framebuffer, so switching is a redraw of the characters that differ.
+	current_page = page;
+	frameIsValid = 0;
+	if (hasDisplayedInfo)
 	{
-		ShiftDisplayLeft(16);
+		RenderCurrentPage();
 	}
-
-	current_page = page;
 }
 
 void ToggleDisplayedPage(void)
 {
-	SwitchToPage(current_page == 1 ? 2 : 1);
+	SwitchToPage(current_page % DISPLAY_PAGE_COUNT + 1);
 }
 
 uint8_t SignalDisplayToggle(void)
@@ -192,7 +825,15 @@ uint8_t SignalDisplayToggle(void)
 	uint32_t elapsedTime = currentTime - lastToggleTime;
 	if (elapsedTime >= DISPLAY_TOGGLE_COOLDOWN_TIME_MS)
 	{
-		ToggleDisplayedPage();
+		if (!hasDisplayedInfo)
+		{
+			ToggleDisplayedPage(); //Nothing to prefetch for, there is no info yet
+		}
+		else
+		{
+			uint8_t page = (requestedPage != 0) ? requestedPage : current_page;
+			requestedPage = page % DISPLAY_PAGE_COUNT + 1;
+		}
 		lastToggleTime = currentTime;
 		return DISPLAY_TOGGLE_ACCEPTED;
 	}
@@ -203,3 +844,23 @@ uint8_t GetCurrentPage(void)
 {
 	return current_page;
 }
+
+uint8_t GetDisplaySources(void)
+{
+	uint8_t sources = pages[current_page - 1].sources;
+	if (requestedPage != 0)
+	{
+		sources |= pages[requestedPage - 1].sources;
+	}
+	return sources;
+}
+
+void ReapplyDisplayedPage(void)
+{
+	Framebuffer_Invalidate(); //Initialization cleared the display
+	frameIsValid = 0; //and the glyphs might be in other slots now
+	if (hasDisplayedInfo)
+	{
+		RenderCurrentPage();
+	}
+}
@@ -10,43 +10,30 @@
 #include "stm32f1xx_hal.h"
 
 static I2C_HandleTypeDef* i2cHandle;
+static uint32_t busByteCount = 0;
 
-//Returns the 12h format equivalent of the given 24h time.
-//Sets isPM to 1 if time is PM. Sets it to 0 if it is AM.
-static uint8_t ConvertFrom24hTo12hFormat(uint8_t timeIn24h, uint8_t* isPM)
+//Converts the contents of an hours register into 00-23. 12h contents are only expected from older firmware.
+static uint8_t HoursRegisterTo24h(uint8_t value)
 {
-	if (timeIn24h == 0)
+	if (value & 0x40) //12h format, bit 5 indicates AM (logic 0) or PM (logic 1)
 	{
-		if (isPM != NULL)
-		{
-			*isPM = 0;
-		}
-		return 12;
-	}
-	else if (timeIn24h < 12)
-	{
-		if (isPM != NULL)
-		{
-			*isPM = 0;
-		}
-		return timeIn24h;
-	}
-	else if (timeIn24h == 12)
-	{
-		if (isPM != NULL)
-		{
-			*isPM = 1;
-		}
-		return timeIn24h;
+		return BCDToBinary(value & 0x1F) % 12 + ((value & 0x20) ? 12 : 0);
 	}
-	else
+	//In 24h format bit 5 is part of BCD formatting
+	return BCDToBinary(value & 0x3F);
+}
+
+//Rewrites an hours register in 24h format if it is in 12h format. Bit 7 is kept, it's A2M3 in the alarm register.
+static HAL_StatusTypeDef ConvertHoursRegisterTo24h(uint16_t registerAddress)
+{
+	uint8_t buffer = 0;
+	HAL_StatusTypeDef status = DS3231_ReadFromRegister(registerAddress, &buffer, 1);
+	if (status != HAL_OK || (buffer & 0x40) == 0)
 	{
-		if (isPM != NULL)
-		{
-			*isPM = 1;
-		}
-		return timeIn24h - 12;
+		return status;
 	}
+	buffer = (buffer & 0x80) | BinaryToBCD(HoursRegisterTo24h(buffer));
+	return DS3231_WriteToRegister(registerAddress, &buffer, 1);
 }
 
 HAL_StatusTypeDef DS3231_Init(I2C_HandleTypeDef* handle)
@@ -68,7 +55,20 @@ HAL_StatusTypeDef DS3231_Init(I2C_HandleTypeDef* handle)
 	  register entirely. The following code sets A2M4 bit.
 	*/
 	uint8_t buffer = 0x80;
-	return DS3231_WriteToRegister(DS3231_REG_ADDR_ALARM2_DAY_OF_WEEK_AND_MONTH, &buffer, 1);
+	HAL_StatusTypeDef status = DS3231_WriteToRegister(DS3231_REG_ADDR_ALARM2_DAY_OF_WEEK_AND_MONTH, &buffer, 1);
+	if (status != HAL_OK)
+	{
+		return status;
+	}
+
+	//The DS3231 always counts in 24h format, the 12h format is only applied when displaying the time.
+	//This way nothing needs to know the format of the registers before writing them.
+	status = ConvertHoursRegisterTo24h(DS3231_REG_ADDR_HOURS);
+	if (status != HAL_OK)
+	{
+		return status;
+	}
+	return ConvertHoursRegisterTo24h(DS3231_REG_ADDR_ALARM2_HOURS);
 }
 
 HAL_StatusTypeDef DS3231_WriteToRegister(uint16_t registerAddress, uint8_t* buffer, uint16_t bufferSize)
@@ -77,6 +77,7 @@ HAL_StatusTypeDef DS3231_WriteToRegister(uint16_t registerAddress, uint8_t* buff
 	{
 		return HAL_ERROR;
 	}
+	busByteCount += 2 + bufferSize; //Address + W, register address, data
 	return HAL_I2C_Mem_Write(i2cHandle, DS3231_DEV_ADDR << 1, registerAddress, I2C_MEMADD_SIZE_8BIT, buffer, bufferSize, HAL_MAX_DELAY);
 }
 
@@ -86,28 +87,42 @@ HAL_StatusTypeDef DS3231_ReadFromRegister(uint16_t registerAddress, uint8_t* buf
 	{
 		return HAL_ERROR;
 	}
+	busByteCount += 3 + bufferSize; //Address + W, register address, address + R after the repeated start, data
 	return HAL_I2C_Mem_Read(i2cHandle, DS3231_DEV_ADDR << 1, registerAddress, I2C_MEMADD_SIZE_8BIT, buffer, bufferSize, HAL_MAX_DELAY);
 }
 
-HAL_StatusTypeDef DS3231_SetTimeFormat(uint8_t is12hrFormat)
+uint32_t DS3231_GetBusByteCount(void)
 {
-	uint8_t currentRegisterValue = 0;
-	HAL_StatusTypeDef status = DS3231_ReadFromRegister(DS3231_REG_ADDR_HOURS, &currentRegisterValue, 1);
-	if (status != HAL_OK)
-	{
-		return status;
-	}
+	return busByteCount;
+}
 
-	if (is12hrFormat) //needs a logic 1 at bit 6
-	{
-		currentRegisterValue |= (1 << 6);
-	}
-	else //needs a logic 0 at bit 6
+HAL_StatusTypeDef DS3231_WriteChangedRegisters(uint16_t firstRegister, const uint8_t* previous, uint8_t* current, uint8_t count, uint8_t* transactions)
+{
+	uint8_t i = 0;
+	while (i < count)
 	{
-		currentRegisterValue &= ~(1 << 6);
+		if (previous[i] == current[i])
+		{
+			i++;
+			continue;
+		}
+		//The registers in between might be counting, so a burst never covers an unchanged register.
+		uint8_t start = i;
+		while (i < count && previous[i] != current[i])
+		{
+			i++;
+		}
+		HAL_StatusTypeDef status = DS3231_WriteToRegister(firstRegister + start, current + start, i - start);
+		if (transactions != NULL)
+		{
+			(*transactions)++;
+		}
+		if (status != HAL_OK)
+		{
+			return status;
+		}
 	}
-
-	return DS3231_WriteToRegister(DS3231_REG_ADDR_HOURS, &currentRegisterValue, 1);
+	return HAL_OK;
 }
 
 HAL_StatusTypeDef DS3231_ReadSeconds(uint8_t* result)
@@ -148,40 +163,11 @@ HAL_StatusTypeDef DS3231_WriteMinutes(uint8_t value)
 	return DS3231_WriteToRegister(DS3231_REG_ADDR_MINUTES, &value, 1);
 }
 
-HAL_StatusTypeDef DS3231_ReadHours(uint8_t* result, uint8_t* is12HrMode, uint8_t* isPM)
+HAL_StatusTypeDef DS3231_ReadHours(uint8_t* result)
 {
 	uint8_t buf = 0;
 	HAL_StatusTypeDef status = DS3231_ReadFromRegister(DS3231_REG_ADDR_HOURS, &buf, 1);
-
-	uint8_t bitmask = 0x40;
-	if (buf & bitmask) //If the 6th bit is set, we are in 12 hour mode
-	{
-		if (is12HrMode)
-		{
-			*is12HrMode = 1;
-		}
-		//bit 5 indicates AM (logic 0) or PM (logic 1)
-		if (isPM)
-		{
-			*isPM = (buf & 0x30) >> 5;
-		}
-		//Clear the AM/PM bit
-		buf &= 0x1F;
-	}
-	else //Otherwise we are in 24 hour mode
-	{
-		if (is12HrMode)
-		{
-			*is12HrMode = 0;
-		}
-		//bit 5 is part of BCD formatting
-		buf &= 0x3F;
-	}
-
-	if (result)
-	{
-		*result = BCDToBinary(buf);
-	}
+	*result = HoursRegisterTo24h(buf);
 	return status;
 }
 
@@ -191,44 +177,9 @@ HAL_StatusTypeDef DS3231_WriteHours(uint8_t value)
 	{
 		value = 23;
 	}
-
-	uint8_t is12HrFormat = 0;
-	DS3231_Is12hrFormatEnabled(&is12HrFormat);
-
-	uint8_t buffer = 0;
-	if (is12HrFormat) // value must be between 1 and 12
-	{
-		uint8_t isPM = 0;
-		value = ConvertFrom24hTo12hFormat(value, &isPM);
-
-		//MSB (bit 7) should be 0. Bit 6 should be 1 for 12h format. Bit 5 indicates AM(0)/PM(1).
-		//Rest is time in BCD.
-		buffer |= 1 << 6;
-		buffer |= isPM << 5;
-		buffer |= BinaryToBCD(value);
-	}
-	else //24 hour format
-	{
-		//MSB (bit 7) should be 0. Bit 6 should be 0 for 24h format. The rest is time in BCD.
-		buffer |= BinaryToBCD(value);
-	}
-	return DS3231_WriteToRegister(DS3231_REG_ADDR_HOURS, &buffer, 1);
-}
-
-HAL_StatusTypeDef DS3231_Is12hrFormatEnabled(uint8_t* result)
-{
-	uint8_t buf = 0;
-	HAL_StatusTypeDef status = DS3231_ReadFromRegister(DS3231_REG_ADDR_HOURS, &buf, 1);
-	*result = (buf & 0x40) >> 6;
-	return status;
-}
-
-HAL_StatusTypeDef DS3231_IsTimePM(uint8_t* result)
-{
-	uint8_t buf = 0;
-	HAL_StatusTypeDef status = DS3231_ReadFromRegister(DS3231_REG_ADDR_HOURS, &buf, 1);
-	*result = (buf & 0x20) >> 5;
-	return status;
+	//MSB (bit 7) should be 0. Bit 6 should be 0 for 24h format. The rest is time in BCD.
+	value = BinaryToBCD(value);
+	return DS3231_WriteToRegister(DS3231_REG_ADDR_HOURS, &value, 1);
 }
 
 HAL_StatusTypeDef DS3231_ReadDayOfTheWeek(uint8_t* result)
@@ -310,7 +261,7 @@ HAL_StatusTypeDef DS3231_ReadCenturyBit(uint8_t* result)
 	uint8_t buffer = 0;
 	HAL_StatusTypeDef status = DS3231_ReadFromRegister(DS3231_REG_ADDR_MONTH_AND_CENTURY, &buffer, 1);
 	uint8_t bitmask = 0x80;
-	*result = BCDToBinary(buffer & bitmask);
+	*result = (buffer & bitmask) != 0;
 	return status;
 }
 
@@ -365,6 +316,22 @@ HAL_StatusTypeDef DS3231_WriteToControlRegister(uint8_t value)
 	return DS3231_WriteToRegister(DS3231_REG_ADDR_CONTROL, &value, 1);
 }
 
+HAL_StatusTypeDef DS3231_EnableSquareWave1Hz(void)
+{
+	uint8_t buffer = 0;
+	HAL_StatusTypeDef status = DS3231_ReadControlRegister(&buffer);
+	if (status != HAL_OK)
+	{
+		return status;
+	}
+
+	//RS2 and RS1 (bits 4 and 3) select the frequency, 00 is 1Hz. INTCN (bit 2) needs to be 0 for the
+	//square wave to be on the pin instead of the alarm interrupts.
+	uint8_t clearMask = ~0x1C;
+	buffer &= clearMask;
+	return DS3231_WriteToControlRegister(buffer);
+}
+
 HAL_StatusTypeDef DS3231_ReadStatusRegister(uint8_t* result)
 {
 	return DS3231_ReadFromRegister(DS3231_REG_ADDR_STATUS, result, 1);
@@ -406,7 +373,7 @@ HAL_StatusTypeDef DS3231_ToggleAlarm(uint8_t value)
 	return DS3231_WriteToControlRegister(buffer);
 }
 
-HAL_StatusTypeDef DS3231_ReadAlarmTime(uint8_t* hours, uint8_t* minutes, uint8_t* is12hFormat, uint8_t* isPM)
+HAL_StatusTypeDef DS3231_ReadAlarmTime(uint8_t* hours, uint8_t* minutes)
 {
 	uint8_t buffer = 0;
 	HAL_StatusTypeDef status = DS3231_ReadFromRegister(DS3231_REG_ADDR_ALARM2_MINS, &buffer, 1);
@@ -428,42 +395,19 @@ HAL_StatusTypeDef DS3231_ReadAlarmTime(uint8_t* hours, uint8_t* minutes, uint8_t
 		return status;
 	}
 
-	uint8_t is12h = (buffer >> 6) & 0x01;
-	if (is12h)
+	if (hours)
 	{
-		if (is12hFormat)
-		{
-			*is12hFormat = 1;
-		}
-		if (isPM)
-		{
-			*isPM = (buffer >> 5) & 0x01;
-		}
-		if (hours)
-		{
-			*hours = BCDToBinary(buffer & 0x1F);
-		}
-	}
-	else
-	{
-		if (is12hFormat)
-		{
-			*is12hFormat = 0;
-		}
-		if (hours)
-		{
-			*hours = BCDToBinary(buffer & 0x3F);
-		}
+		//MSB is A2M3, it doesn't mean anything for hours.
+		*hours = HoursRegisterTo24h(buffer & 0x7F);
 	}
-
 	return status;
 }
 
-HAL_StatusTypeDef DS3231_SetAlarmTime(uint8_t hoursIn24hFormat, uint8_t minutes)
+HAL_StatusTypeDef DS3231_SetAlarmTime(uint8_t hours, uint8_t minutes)
 {
-	if (hoursIn24hFormat > 23)
+	if (hours > 23)
 	{
-		hoursIn24hFormat = 23;
+		hours = 23;
 	}
 	if (minutes > 59)
 	{
@@ -480,38 +424,18 @@ HAL_StatusTypeDef DS3231_SetAlarmTime(uint8_t hoursIn24hFormat, uint8_t minutes)
 		return status;
 	}
 
-	uint8_t formatIs12Hr = 0;
-	status = DS3231_Is12hrFormatEnabled(&formatIs12Hr);
-	if (status != HAL_OK)
-	{
-		return status;
-	}
-
-	if (formatIs12Hr)
-	{
-		uint8_t isPM = 0;
-		uint8_t hoursIn12hFormat = ConvertFrom24hTo12hFormat(hoursIn24hFormat, &isPM);
-		hoursIn12hFormat = BinaryToBCD(hoursIn12hFormat);
-		hoursIn12hFormat &= ~(1 << 7); //MSB needs to be set to 0.
-		hoursIn12hFormat |= 1 << 6; //2nd MSB needs to be set to 1 for 12 hour format.
-		hoursIn12hFormat |= isPM << 5; //Bit 5 needs to be set to 1 for PM, 0 for AM.
-		return DS3231_WriteToRegister(DS3231_REG_ADDR_ALARM2_HOURS, &hoursIn12hFormat, 1);
-	}
-	else //24 hour format
-	{
-		hoursIn24hFormat = BinaryToBCD(hoursIn24hFormat);
-		//MSB needs to be set to zero for correct alarm detection.
-		//2nd MSB needs to be set to zero to indicate 24h time format.
-		hoursIn24hFormat &= 0x3F;
-		return DS3231_WriteToRegister(DS3231_REG_ADDR_ALARM2_HOURS, &hoursIn24hFormat, 1);
-	}
+	hours = BinaryToBCD(hours);
+	//MSB needs to be set to zero for correct alarm detection.
+	//2nd MSB needs to be set to zero to indicate 24h time format.
+	hours &= 0x3F;
+	return DS3231_WriteToRegister(DS3231_REG_ADDR_ALARM2_HOURS, &hours, 1);
 }
 
 HAL_StatusTypeDef DS3231_IsAlarmTime(uint8_t* result)
 {
-	uint8_t clockHours = 0, clockMinutes = 0, isClock12hrMode = 0, isClockPM = 0;
-	uint8_t alarmHours = 0, alarmMinutes = 0, isAlarm12hrMode = 0, isAlarmPM = 0;
-	HAL_StatusTypeDef status = DS3231_ReadHours(&clockHours, &isClock12hrMode, &isClockPM);
+	uint8_t clockHours = 0, clockMinutes = 0;
+	uint8_t alarmHours = 0, alarmMinutes = 0;
+	HAL_StatusTypeDef status = DS3231_ReadHours(&clockHours);
 	if (status != HAL_OK)
 	{
 		return status;
@@ -523,25 +447,14 @@ HAL_StatusTypeDef DS3231_IsAlarmTime(uint8_t* result)
 		return status;
 	}
 
-	status = DS3231_ReadAlarmTime(&alarmHours, &alarmMinutes, &isAlarm12hrMode, &isAlarmPM);
+	status = DS3231_ReadAlarmTime(&alarmHours, &alarmMinutes);
 	if (status != HAL_OK)
 	{
 		return status;
 	}
 
-	//Ensure both of the times are calculated as 12 hour modes
-	//(just because we already have a function to convert from 24hr to 12hr format)
-	if (!isClock12hrMode)
-	{
-		clockHours = ConvertFrom24hTo12hFormat(clockHours, &isClockPM);
-	}
-
-	if (!isAlarm12hrMode)
-	{
-		alarmHours = ConvertFrom24hTo12hFormat(alarmHours, &isAlarmPM);
-	}
-
-	*result = (clockHours == alarmHours) && (clockMinutes == alarmMinutes) && (isClockPM == isAlarmPM);
+	//Both are in 24h format, so the minutes of the day can be compared directly.
+	*result = (clockHours * 60 + clockMinutes) == (alarmHours * 60 + alarmMinutes);
 	return status;
 }
 
@@ -574,3 +487,46 @@ HAL_StatusTypeDef DS3231_ReadTemperature(uint16_t* result)
 
 	return status;
 }
+
+HAL_StatusTypeDef DS3231_ReadUserByte(uint8_t* result)
+{
+	return DS3231_ReadFromRegister(DS3231_REG_ADDR_USER_BYTE, result, 1);
+}
+
+HAL_StatusTypeDef DS3231_WriteUserByte(uint8_t value)
+{
+	return DS3231_WriteToRegister(DS3231_REG_ADDR_USER_BYTE, &value, 1);
+}
+
+//Limits value to the range [min, max].
+static uint8_t ClampToRange(uint8_t value, uint8_t min, uint8_t max)
+{
+	if (value < min)
+	{
+		return min;
+	}
+	if (value > max)
+	{
+		return max;
+	}
+	return value;
+}
+
+void DS3231_EncodeTimeRegisters(uint8_t* registers, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t dayOfTheWeek, uint8_t dayOfTheMonth, uint8_t month, uint8_t year)
+{
+	//Same encodings as the write functions of each register use.
+	registers[DS3231_REG_ADDR_SECONDS - DS3231_REG_ADDR_SECONDS] = BinaryToBCD(ClampToRange(seconds, 0, 59));
+	registers[DS3231_REG_ADDR_MINUTES - DS3231_REG_ADDR_SECONDS] = BinaryToBCD(ClampToRange(minutes, 0, 59));
+	registers[DS3231_REG_ADDR_HOURS - DS3231_REG_ADDR_SECONDS] = BinaryToBCD(ClampToRange(hours, 0, 23)); //Bit 6 = 0 for 24h format
+	registers[DS3231_REG_ADDR_DAY_OF_WEEK - DS3231_REG_ADDR_SECONDS] = ClampToRange(dayOfTheWeek, 1, 7);
+	registers[DS3231_REG_ADDR_DAY_OF_MONTH - DS3231_REG_ADDR_SECONDS] = BinaryToBCD(ClampToRange(dayOfTheMonth, 1, 31));
+	registers[DS3231_REG_ADDR_MONTH_AND_CENTURY - DS3231_REG_ADDR_SECONDS] = BinaryToBCD(ClampToRange(month, 1, 12)); //Century bit = 0
+	registers[DS3231_REG_ADDR_YEAR - DS3231_REG_ADDR_SECONDS] = BinaryToBCD(ClampToRange(year, 0, 99));
+}
+
+void DS3231_EncodeAlarmRegisters(uint8_t* registers, uint8_t hours, uint8_t minutes)
+{
+	//A2M2 and A2M3 (the MSBs) are 0, the hours are in 24h format.
+	registers[DS3231_REG_ADDR_ALARM2_MINS - DS3231_REG_ADDR_ALARM2_MINS] = BinaryToBCD(ClampToRange(minutes, 0, 59));
+	registers[DS3231_REG_ADDR_ALARM2_HOURS - DS3231_REG_ADDR_ALARM2_MINS] = BinaryToBCD(ClampToRange(hours, 0, 23));
+}
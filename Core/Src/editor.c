@@ -6,6 +6,8 @@
  */
 
 #include "editor.h"
+#include "lcd_framebuffer.h"
+#include <string.h>
 
 typedef enum CURRENTLY_EDITING
 {
@@ -22,10 +24,47 @@ typedef enum CURRENTLY_EDITING
 } CURRENTLY_EDITING;
 
 static CURRENTLY_EDITING currentlyEditedValue = CURRENTLY_EDITING_HOURS;
+static EditorStats stats = { 0 };
+static DisplayInfo infoBeforeEditing; //Only the edited values that differ from this are written back
+
+//Where the alarm is shown, the overview has it on the third line.
+#if DISPLAY_USE_OVERVIEW_PAGE
+#define ALARM_LINE				3
+#define ALARM_HOURS_COLUMN		8
+#define ALARM_MINUTES_COLUMN	11
+#else
+#define ALARM_LINE				1
+#define ALARM_HOURS_COLUMN		7
+#define ALARM_MINUTES_COLUMN	10
+#endif
+
+//Where the cursor is put while a value is edited, on the last digit of its field. In the order of CURRENTLY_EDITING.
+static const struct
+{
+	uint8_t line;
+	uint8_t column;
+} cursorPositions[CURRENTLY_EDITING_COUNT] =
+{
+	{ 1, 2 }, //Hours
+	{ 1, 5 }, //Minutes
+	{ 1, 8 }, //Seconds
+	{ 2, 2 }, //Day of the month
+	{ 2, 6 }, //Month
+	{ 2, 11 }, //Year
+	{ 2, 16 }, //Day of the week
+	{ ALARM_LINE, ALARM_HOURS_COLUMN },
+	{ ALARM_LINE, ALARM_MINUTES_COLUMN },
+};
+
+//Puts the cursor on the value being edited.
+static void MoveCursorToEditedValue(void)
+{
+	Framebuffer_MoveCursor(cursorPositions[currentlyEditedValue].line, cursorPositions[currentlyEditedValue].column);
+}
 
 //Makes sure a value changes only in a given range. If the value exceeds the boundaries,
 //the opposite boundary is returned.
-static uint8_t ClampWrapped(uint8_t value, uint8_t min, uint8_t max)
+static uint8_t ClampWrapped(int16_t value, uint8_t min, uint8_t max)
 {
 	if (max < min)
 	{
@@ -45,101 +84,85 @@ static uint8_t ClampWrapped(uint8_t value, uint8_t min, uint8_t max)
 
 void HandleDisplayDuringEditing(const DisplayInfo* info)
 {
-	switch (currentlyEditedValue)
+	//The alarm is edited on its own page, everything else on the time page.
+	uint8_t editingAlarm = currentlyEditedValue == CURRENTLY_EDITING_ALARM_HOURS ||
+						   currentlyEditedValue == CURRENTLY_EDITING_ALARM_MINUTES;
+	uint8_t page = editingAlarm ? DISPLAY_PAGE_ALARM : DISPLAY_PAGE_TIME;
+	if (GetCurrentPage() != page)
 	{
-	case CURRENTLY_EDITING_HOURS:
-		MoveCursor(1, 2);
-		break;
-	case CURRENTLY_EDITING_MINUTES:
-		MoveCursor(1, 5);
-		break;
-	case CURRENTLY_EDITING_SECONDS:
-		MoveCursor(1, 8);
-		break;
-	case CURRENTLY_EDITING_DAY_OF_MONTH:
-		MoveCursor(2, 2);
-		break;
-	case CURRENTLY_EDITING_MONTH:
-		MoveCursor(2, 6);
-		break;
-	case CURRENTLY_EDITING_YEAR:
-		MoveCursor(2, 11);
-		break;
-	case CURRENTLY_EDITING_DAY_OF_WEEK:
-		MoveCursor(2, 16);
-		break;
-	case CURRENTLY_EDITING_ALARM_HOURS:
-		MoveCursor(1, 23);
-		break;
-	case CURRENTLY_EDITING_ALARM_MINUTES:
-		MoveCursor(1, 26);
-		break;
-	default:
-		//Don't do anything.
-		break;
+		SwitchToPage(page);
 	}
+	MoveCursorToEditedValue();
 }
 
-void IncrementCurrentlyEditedValue(DisplayInfo* info)
+//Adds step (+1 or -1) to the edited value and displays it.
+static void StepCurrentlyEditedValue(DisplayInfo* info, int8_t step)
 {
+	uint32_t start = DWT->CYCCNT;
 	switch (currentlyEditedValue)
 	{
 	case CURRENTLY_EDITING_HOURS:
-		if (info->displayFormat == DISPLAY_FORMAT_12H)
-		{
-			info->hours = ClampWrapped(info->hours + 1, 1, 12);
-		}
-		else
-		{
-			info->hours = ClampWrapped(info->hours + 1, 0, 23);
-		}
+		//Always 24h, in 12h format this goes through 12 AM to 11 PM.
+		info->hours = ClampWrapped(info->hours + step, 0, 23);
 		break;
 	case CURRENTLY_EDITING_MINUTES:
-		info->minutes = ClampWrapped(info->minutes + 1, 0, 59);
+		info->minutes = ClampWrapped(info->minutes + step, 0, 59);
 		break;
 	case CURRENTLY_EDITING_SECONDS:
-		info->seconds = ClampWrapped(info->seconds + 1, 0, 59);
+		info->seconds = ClampWrapped(info->seconds + step, 0, 59);
 		break;
 	case CURRENTLY_EDITING_DAY_OF_MONTH:
-		info->dayOfTheMonth = ClampWrapped(info->dayOfTheMonth + 1, 1, 31);
+		info->dayOfTheMonth = ClampWrapped(info->dayOfTheMonth + step, 1, 31);
 		break;
 	case CURRENTLY_EDITING_MONTH:
-		info->month = ClampWrapped(info->month + 1, 1, 12);
+		info->month = ClampWrapped(info->month + step, 1, 12);
 		break;
 	case CURRENTLY_EDITING_YEAR:
 		//year is 16 bit, don't use Clamp() as it works on uint8_t.
 		//Sure I could make it take in uint16_t too but oh well, didn't feel like that was necessary.
-		info->year = (info->year + 1) % 10000; //Max allowed year is 9999
+		info->year = (info->year + 10000 + step) % 10000; //Max allowed year is 9999
 		break;
 	case CURRENTLY_EDITING_DAY_OF_WEEK:
-		info->dayOfTheWeek = ClampWrapped(info->dayOfTheWeek + 1, 1, 7);
+		info->dayOfTheWeek = ClampWrapped(info->dayOfTheWeek + step, 1, 7);
 		break;
 	case CURRENTLY_EDITING_ALARM_HOURS:
-		if (info->displayFormat == DISPLAY_FORMAT_12H)
-		{
-			info->alarmHours = ClampWrapped(info->alarmHours + 1, 1, 12);
-		}
-		else
-		{
-			info->alarmHours = ClampWrapped(info->alarmHours + 1, 0, 23);
-		}
+		info->alarmHours = ClampWrapped(info->alarmHours + step, 0, 23);
 		break;
 	case CURRENTLY_EDITING_ALARM_MINUTES:
-		info->alarmMinutes = ClampWrapped(info->alarmMinutes + 1, 0, 59);
+		info->alarmMinutes = ClampWrapped(info->alarmMinutes + step, 0, 59);
 		break;
 	default:
 		//Don't do anything.
 		break;
 	}
-	//Update the display here because if the display is updated in the display handling method, the cursor
-	//gets messed up for some reason, whether this function is called before or after the switch statement.
-	//Updating the display here essentially means the display is updated only once when necessary and then the
-	//display handling function takes control back again.
-	DisplayTime(info);
+	//Only the field of the edited value differs from the screen, so only its changed characters are written.
+	//Writing them moves the LCD cursor, put it back on the value.
+	uint32_t written = DisplayEditedInfo(info);
+	MoveCursorToEditedValue();
+
+	uint32_t cycles = DWT->CYCCNT - start;
+	stats.increments++;
+	stats.lastIncrementCycles = cycles;
+	if (cycles > stats.maxIncrementCycles)
+	{
+		stats.maxIncrementCycles = cycles;
+	}
+	stats.lastIncrementCharacters = written;
 }
 
-void StartEditing(void)
+void IncrementCurrentlyEditedValue(DisplayInfo* info)
 {
+	StepCurrentlyEditedValue(info, 1);
+}
+
+void DecrementCurrentlyEditedValue(DisplayInfo* info)
+{
+	StepCurrentlyEditedValue(info, -1);
+}
+
+void StartEditing(const DisplayInfo* info)
+{
+	memcpy(&infoBeforeEditing, info, sizeof(DisplayInfo));
 	currentlyEditedValue = CURRENTLY_EDITING_HOURS;
 	DisplayAndCursorControl(1, 0, 1);
 }
@@ -156,3 +179,13 @@ uint8_t SwitchNextToEdit(void)
 	//and we wrapped back to the beginning.
 	return currentlyEditedValue == 0;
 }
+
+const DisplayInfo* GetInfoBeforeEditing(void)
+{
+	return &infoBeforeEditing;
+}
+
+const EditorStats* GetEditorStats(void)
+{
+	return &stats;
+}
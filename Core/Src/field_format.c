@@ -0,0 +1,106 @@
+/*
+ * field_format.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <field_format.h>
+
+//"00" to "99" back to back. Two digits are copied per division instead of one.
+static const char digitPairs[200] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+char* Format_TwoDigits(char* out, uint32_t value)
+{
+	const char* pair = &digitPairs[(value % 100) * 2];
+	out[0] = pair[0];
+	out[1] = pair[1];
+	return out + 2;
+}
+
+char* Format_FourDigits(char* out, uint32_t value)
+{
+	value %= 10000;
+	out = Format_TwoDigits(out, value / 100);
+	return Format_TwoDigits(out, value);
+}
+
+char* Format_Time(char* out, uint8_t hours, uint8_t minutes)
+{
+	out = Format_TwoDigits(out, hours);
+	*out++ = ':';
+	return Format_TwoDigits(out, minutes);
+}
+
+char* Format_Unsigned(char* out, uint32_t value, uint8_t width)
+{
+	//Digits are produced from the lowest one, so build them at the end of a scratch buffer.
+	char digits[10];
+	uint8_t count = 0;
+	do
+	{
+		const char* pair = &digitPairs[(value % 100) * 2];
+		digits[9 - count++] = pair[1];
+		digits[9 - count++] = pair[0];
+		value /= 100;
+	} while (value != 0 && count < 10);
+	if (count > 1 && digits[10 - count] == '0')
+	{
+		count--; //The last pair had a single digit
+	}
+
+	if (width == 0)
+	{
+		width = count;
+	}
+	for (uint8_t i = count; i < width; i++)
+	{
+		*out++ = ' ';
+	}
+	if (count > width)
+	{
+		count = width;
+	}
+	for (uint8_t i = 10 - count; i < 10; i++)
+	{
+		*out++ = digits[i];
+	}
+	return out;
+}
+
+char* Format_Centi(char* out, int32_t centi)
+{
+	uint32_t magnitude = centi < 0 ? -(uint32_t)centi : (uint32_t)centi;
+	*out++ = centi < 0 ? '-' : '+';
+	uint32_t integerPart = magnitude / 100;
+	out = integerPart < 100 ? Format_TwoDigits(out, integerPart) : Format_Unsigned(out, integerPart, 0);
+	*out++ = '.';
+	return Format_TwoDigits(out, magnitude);
+}
+
+char* Format_Text(char* out, const char* text)
+{
+	while (*text != '\0')
+	{
+		*out++ = *text++;
+	}
+	return out;
+}
+
+char* Format_Fill(char* out, char character, uint8_t count)
+{
+	for (uint8_t i = 0; i < count; i++)
+	{
+		*out++ = character;
+	}
+	return out;
+}
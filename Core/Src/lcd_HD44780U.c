@@ -6,127 +6,696 @@
  */
 
 #include <lcd_HD44780U.h>
+#include <cycle_delay.h>
 #include "main.h"
 #include <string.h>
 #include "stm32f1xx_hal.h"
 
 //All the addresses below are taken from the datasheet
 static const uint8_t FIRST_LINE_START_ADDRESS_IN_DDRAM = 0x00;
-static const uint8_t FIRST_LINE_END_ADDRESS_IN_DDRAM = 0x27; //0x00 + 40 = 0x27 (both lines are 40 chars long)
+static const uint8_t FIRST_LINE_END_ADDRESS_IN_DDRAM = 0x00 + LCD_DDRAM_LINE_LENGTH - 1;
 static const uint8_t SECOND_LINE_START_ADDRESS_IN_DDRAM = 0x40;
-static const uint8_t SECOND_LINE_END_ADDRESS_IN_DDRAM = 0x67; //0x40 + 40 = 0x67 (both lines are 40 chars long)
+static const uint8_t SECOND_LINE_END_ADDRESS_IN_DDRAM = 0x40 + LCD_DDRAM_LINE_LENGTH - 1;
 
-static void DWT_Init(void)
+//Bus timings in CPU cycles, from the 4.5-5.5V bus timing tables of the datasheet.
+#define TAS_CYCLES				DELAY_NS_TO_CYCLES(40) //RS/RW setup before enable rises
+#define PWEH_CYCLES				DELAY_NS_TO_CYCLES(230) //Enable high pulse width, covers tDSW = 80 ns as well
+#define TDDR_CYCLES				DELAY_NS_TO_CYCLES(160) //Enable rise to read data valid
+//Enable low time. Has to cover the hold times (tAH, tH, tDHR, 10 ns at most) and the rest of tcycE = 500 ns.
+#define ENABLE_LOW_CYCLES		DELAY_NS_TO_CYCLES(500 - 230 - 40)
+//The address counter is updated 1.5 clock periods of the chip after the busy flag turns off.
+#define TADD_CYCLES				DELAY_NS_TO_CYCLES(1500000000ULL / LCD_FOSC_HZ)
+
+//The bus is spread over two ports. D0-D3 are on the data port, RS, RW, EN and D4-D7 are on the control port.
+//In 4-bit mode, the data port isn't used.
+#define LCD_DATA_PORT			Pin_D0_GPIO_Port
+#define LCD_CONTROL_PORT		Pin_EN_GPIO_Port
+
+//RW is never driven in write-only mode. A pin mask of 0 makes the BSRR writes leave it alone.
+#if LCD_USE_WRITE_ONLY_MODE
+#define LCD_RW_PIN				0
+#else
+#define LCD_RW_PIN				Pin_RW_Pin
+#endif
+
+#if LCD_USE_4BIT_MODE
+#define BUS_CYCLES_PER_INSTRUCTION	2
+//Pins in the same order as the bits of a bus cycle (RS-RW-D7-D6-D5-D4). An instruction takes two bus cycles,
+//the upper nibble is sent first.
+static GPIO_TypeDef* const instructionPorts[] = { Pin_RS_GPIO_Port, Pin_RW_GPIO_Port, Pin_D7_GPIO_Port, Pin_D6_GPIO_Port,
+												  Pin_D5_GPIO_Port, Pin_D4_GPIO_Port };
+static const uint16_t instructionPins[] = { Pin_RS_Pin, LCD_RW_PIN, Pin_D7_Pin, Pin_D6_Pin, Pin_D5_Pin, Pin_D4_Pin };
+
+//Bus values of the two cycles of an instruction. RS and RW are the same in both.
+#define UPPER_NIBBLE_CYCLE(instruction)		(((instruction) >> 4) & 0x3F)
+#define LOWER_NIBBLE_CYCLE(instruction)		((((instruction) >> 4) & 0x30) | ((instruction) & 0x0F))
+#else
+#define BUS_CYCLES_PER_INSTRUCTION	1
+//Pins in the same order as the bits of an instruction (RS-RW-D7-D6-D5-D4-D3-D2-D1-D0)
+static GPIO_TypeDef* const instructionPorts[] = { Pin_RS_GPIO_Port, Pin_RW_GPIO_Port, Pin_D7_GPIO_Port, Pin_D6_GPIO_Port,
+												  Pin_D5_GPIO_Port, Pin_D4_GPIO_Port, Pin_D3_GPIO_Port, Pin_D2_GPIO_Port,
+												  Pin_D1_GPIO_Port, Pin_D0_GPIO_Port };
+static const uint16_t instructionPins[] = { Pin_RS_Pin, LCD_RW_PIN, Pin_D7_Pin, Pin_D6_Pin, Pin_D5_Pin,
+											Pin_D4_Pin, Pin_D3_Pin, Pin_D2_Pin, Pin_D1_Pin, Pin_D0_Pin };
+#endif
+
+//BSRR words of all the bus cycles of an instruction, ready to be written to the ports.
+typedef struct EncodedInstruction
+{
+	uint32_t dataPortWords[BUS_CYCLES_PER_INSTRUCTION];
+	uint32_t controlPortWords[BUS_CYCLES_PER_INSTRUCTION];
+} EncodedInstruction;
+
+static LCD_DebugStats debugStats = { 0 };
+static uint8_t statsFrameDepth = 0;
+static uint32_t statsFrameCharacters = 0;
+
+//The per-primitive counters can be compiled out, the rest of the statistics is always collected.
+#if LCD_COLLECT_STATS
+#define STATS_TIMESTAMP()			(DWT->CYCCNT)
+#define STATS_ADD(field, value)		(debugStats.field += (value))
+#else
+#define STATS_TIMESTAMP()			0
+#define STATS_ADD(field, value)		((void)(value))
+#endif
+
+static LCD_Health health = LCD_HEALTH_OK;
+static uint32_t lastReinitAttemptTick = 0;
+#if !LCD_USE_WRITE_ONLY_MODE
+//Worst-case execution times in CPU cycles, busy flag waits give up after these. Filled in by Init16x2LCD().
+static uint32_t busyTimeoutCycles = 0;
+static uint32_t longBusyTimeoutCycles = 0;
+//Bound of the next busy flag wait, set from the last instruction sent.
+static uint32_t nextBusyTimeoutCycles = 0;
+static uint8_t consecutiveTimeouts = 0;
+#endif
+
+#if LCD_USE_DMA_STREAMING
+//TIM3's update event requests DMA1 channel 3 and its compare 1 event requests DMA1 channel 6 (see the
+//reference manual's DMA request mapping). Channel 3 feeds the data port, channel 6 feeds the control port.
+#define LCD_DMA_DATA_CHANNEL		DMA1_Channel3
+#define LCD_DMA_CONTROL_CHANNEL		DMA1_Channel6
+#if LCD_USE_4BIT_MODE
+#define LCD_DMA_TRANSFER_COMPLETE	DMA_ISR_TCIF6
+#define LCD_DMA_CLEAR_FLAGS			DMA_IFCR_CGIF6
+#else
+#define LCD_DMA_TRANSFER_COMPLETE	(DMA_ISR_TCIF3 | DMA_ISR_TCIF6)
+#define LCD_DMA_CLEAR_FLAGS			(DMA_IFCR_CGIF3 | DMA_IFCR_CGIF6)
+
+static uint32_t dmaDataPortSteps[LCD_DMA_MAX_STEPS];
+#endif
+static uint32_t dmaControlPortSteps[LCD_DMA_MAX_STEPS];
+static uint16_t dmaStepCount = 0;
+static uint8_t dmaFrameDepth = 0; //Frames can be nested, only the outermost LCD_EndFrame() starts the transfer.
+static uint8_t dmaStreaming = 0;
+static uint32_t dmaFrameStartCycle = 0;
+static uint32_t dmaFrameWaitCycles = 0; //Cycles spent waiting for the DMA when a frame overflows the buffer.
+static uint32_t dmaFrameStartSteps = 0;
+#endif
+
+#if LCD_USE_WRITE_ONLY_MODE
+//Execution times of the instruction classes in CPU cycles, scaled for LCD_FOSC_HZ. Filled in by Init16x2LCD().
+static uint32_t instructionCycles = 0;
+static uint32_t longInstructionCycles = 0;
+static uint32_t dataWriteCycles = 0;
+//DWT cycle count at which the chip is done with the last instruction.
+static uint32_t readyAtCycle = 0;
+//The address counter can't be read back, so keep track of it here. CGRAM and DDRAM addresses are followed
+//separately, data goes to the one that was set last.
+static uint8_t ddramAddress = 0;
+static uint8_t cgramAddress = 0;
+static uint8_t addressesCGRAM = 0;
+static uint8_t addressIncrements = 1;
+#endif
+
+//Waits until cycles CPU cycles have passed since start, counting the wait as delay.
+static void DelayCyclesFrom(uint32_t start, uint32_t cycles)
 {
-	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; //Enable debug trace
-	DWT->CYCCNT = 0; //Reset the cycle counter
-	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; //Enable the cycle counter
+	uint32_t delayStart = STATS_TIMESTAMP();
+	Delay_CyclesFrom(start, cycles);
+	STATS_ADD(delayCycles, STATS_TIMESTAMP() - delayStart);
 }
 
-static void DWT_delay_us(uint32_t delay)
+static void DelayCycles(uint32_t cycles)
 {
-	uint32_t start = DWT->CYCCNT;
-	uint32_t cpuCyclesPerMicrosecond = HAL_RCC_GetHCLKFreq() / 1000000;
-	uint32_t requiredCycles = delay * cpuCyclesPerMicrosecond;
+	DelayCyclesFrom(DWT->CYCCNT, cycles);
+}
+
+//Returns the class of the instruction, which is decided by its highest set bit.
+static LCD_InstructionClass ClassifyInstruction(uint16_t instruction)
+{
+	if (instruction & 0b1000000000)
+	{
+		return (instruction & 0b0100000000) ? LCD_INSTRUCTION_DATA_READ : LCD_INSTRUCTION_DATA_WRITE;
+	}
+	if (instruction & 0b0100000000)
+	{
+		return LCD_INSTRUCTION_ADDRESS_READ;
+	}
+	for (int bit = 7; bit >= 0; bit--)
+	{
+		if (instruction & (1 << bit))
+		{
+			//LCD_INSTRUCTION_CLEAR to LCD_INSTRUCTION_SET_DDRAM_ADDRESS are in the order of their bits.
+			return (LCD_InstructionClass)(LCD_INSTRUCTION_CLEAR + bit);
+		}
+	}
+	return LCD_INSTRUCTION_CLEAR; //Not a valid instruction, count it somewhere
+}
+
+static void CountInstruction(uint16_t instruction)
+{
+	LCD_InstructionClass instructionClass = ClassifyInstruction(instruction);
+	STATS_ADD(instructionCounts[instructionClass], 1);
+	if (instructionClass == LCD_INSTRUCTION_DATA_WRITE && statsFrameDepth > 0)
+	{
+		statsFrameCharacters++;
+	}
+}
+
+//Converts the value of one bus cycle into BSRR words for the data and the control ports. RS, RW and the data
+//pins are driven to the bits of the value and EN is driven low. In 8-bit mode, a bus cycle is a whole instruction.
+static void EncodeBusCycle(uint16_t busValue, uint32_t* dataPortWord, uint32_t* controlPortWord)
+{
+	uint32_t dataWord = 0;
+	uint32_t controlWord = (uint32_t)Pin_EN_Pin << 16;
+	for (int i = 0; i < arr_size(instructionPins); i++)
+	{
+		//Lower half of BSRR sets the pin, upper half resets it.
+		uint32_t word = instructionPins[i];
+		if (((busValue >> ((arr_size(instructionPins) - 1) - i)) & 0x1) == 0)
+		{
+			word <<= 16;
+		}
+
+		if (instructionPorts[i] == LCD_CONTROL_PORT)
+		{
+			controlWord |= word;
+		}
+		else
+		{
+			dataWord |= word;
+		}
+	}
+	*dataPortWord = dataWord;
+	*controlPortWord = controlWord;
+}
 
-	//Wait until enough cycles has passed
-	while ((DWT->CYCCNT - start) < requiredCycles) { }
+static void EncodeInstruction(uint16_t instruction, EncodedInstruction* encoded)
+{
+#if LCD_USE_4BIT_MODE
+	EncodeBusCycle(UPPER_NIBBLE_CYCLE(instruction), &encoded->dataPortWords[0], &encoded->controlPortWords[0]);
+	EncodeBusCycle(LOWER_NIBBLE_CYCLE(instruction), &encoded->dataPortWords[1], &encoded->controlPortWords[1]);
+#else
+	EncodeBusCycle(instruction, &encoded->dataPortWords[0], &encoded->controlPortWords[0]);
+#endif
+}
+
+//Converts a datasheet execution time into CPU cycles for a chip running at foscHz.
+static uint32_t MicrosecondsToLCDCycles(uint32_t us, uint32_t foscHz)
+{
+	//The execution times scale with the clock of the chip.
+	uint32_t scaledUs = (uint32_t)(((uint64_t)us * LCD_FOSC_NOMINAL_HZ + foscHz - 1) / foscHz);
+	return Delay_MicrosecondsToCycles(scaledUs);
+}
+
+#if LCD_USE_WRITE_ONLY_MODE
+static void InitExecutionTimeModel(void)
+{
+	instructionCycles = MicrosecondsToLCDCycles(LCD_INSTRUCTION_TIME_US, LCD_FOSC_HZ);
+	longInstructionCycles = MicrosecondsToLCDCycles(LCD_LONG_INSTRUCTION_TIME_US, LCD_FOSC_HZ);
+	dataWriteCycles = MicrosecondsToLCDCycles(LCD_DATA_WRITE_TIME_US, LCD_FOSC_HZ);
+	readyAtCycle = DWT->CYCCNT;
+}
+
+//Moves a DDRAM address by one, wrapping from the end of a line to the start of the other one like the chip does.
+static uint8_t StepDDRAMAddress(uint8_t address, uint8_t increment)
+{
+	if (increment)
+	{
+		return (address == FIRST_LINE_END_ADDRESS_IN_DDRAM) ? SECOND_LINE_START_ADDRESS_IN_DDRAM :
+			   (address == SECOND_LINE_END_ADDRESS_IN_DDRAM) ? FIRST_LINE_START_ADDRESS_IN_DDRAM :
+			   address + 1;
+	}
+	return (address == SECOND_LINE_START_ADDRESS_IN_DDRAM) ? FIRST_LINE_END_ADDRESS_IN_DDRAM :
+		   (address == FIRST_LINE_START_ADDRESS_IN_DDRAM) ? SECOND_LINE_END_ADDRESS_IN_DDRAM :
+		   address - 1;
 }
 
+//Follows the effect of the instruction on the address counter and returns its execution time in CPU cycles.
+static uint32_t TrackInstruction(uint16_t instruction)
+{
+	uint32_t executionCycles = instructionCycles;
+	if (instruction & 0b1000000000) //Data write
+	{
+		executionCycles = dataWriteCycles;
+		if (addressesCGRAM)
+		{
+			//CGRAM addresses are 6 bits and simply wrap around.
+			cgramAddress = (cgramAddress + (addressIncrements ? 1 : -1)) & 0x3F;
+		}
+		else
+		{
+			ddramAddress = StepDDRAMAddress(ddramAddress, addressIncrements);
+		}
+	}
+	else if (instruction & 0b0010000000) //Set DDRAM address
+	{
+		ddramAddress = instruction & 0x7F;
+		addressesCGRAM = 0;
+	}
+	else if (instruction & 0b0001000000) //Set CGRAM address
+	{
+		cgramAddress = instruction & 0x3F;
+		addressesCGRAM = 1;
+	}
+	else if ((instruction & 0b1111111100) == 0) //Clear display, return home
+	{
+		executionCycles = longInstructionCycles;
+		ddramAddress = 0;
+		addressesCGRAM = 0;
+		if (instruction & 0b0000000001) //Clear display also sets the entry mode to increment
+		{
+			addressIncrements = 1;
+		}
+	}
+	else if ((instruction & 0b1111110000) == 0b0000010000) //Cursor or display shift
+	{
+		//A display shift leaves the address counter alone, a cursor shift moves it like a write does.
+		if ((instruction & 0b0000001000) == 0 && !addressesCGRAM)
+		{
+			ddramAddress = StepDDRAMAddress(ddramAddress, (instruction >> 2) & 0x1);
+		}
+	}
+	else if ((instruction & 0b1111111100) == 0b0000000100) //Entry mode set
+	{
+		addressIncrements = (instruction >> 1) & 0x1;
+	}
+	return executionCycles;
+}
+#endif
+
 //For input, pass GPIO_MODE_INPUT. For output, pass GPIO_MODE_OUTPUT_PP.
 static void ChangeGPIOPortModes(uint32_t mode)
 {
+	uint32_t start = STATS_TIMESTAMP();
 	GPIO_InitTypeDef gpioInit = { 0 };
 	gpioInit.Mode = mode;
-	gpioInit.Pull = GPIO_NOPULL;
+	//Pull the inputs up so that a disconnected LCD reads as permanently busy and gets detected by the busy
+	//flag timeouts. The chip drives the bus strongly, the pull-ups don't affect normal reads.
+	gpioInit.Pull = (mode == GPIO_MODE_INPUT) ? GPIO_PULLUP : GPIO_NOPULL;
 	gpioInit.Speed = GPIO_SPEED_FREQ_LOW;
 
+#if !LCD_USE_4BIT_MODE
 	//Change GPIOA (D0-D3)
 	gpioInit.Pin = Pin_D0_Pin | Pin_D1_Pin | Pin_D2_Pin | Pin_D3_Pin;
 	HAL_GPIO_Init(GPIOA, &gpioInit);
+#endif
 
 	//Change GPIOB (D4-D7)
 	gpioInit.Pin = Pin_D4_Pin | Pin_D5_Pin | Pin_D6_Pin | Pin_D7_Pin;
 	HAL_GPIO_Init(GPIOB, &gpioInit);
+	STATS_ADD(portModeSwitches, 1);
+	STATS_ADD(portModeSwitchCycles, STATS_TIMESTAMP() - start);
 }
 
-//This function expects which read operation needs to be done to already be specified. e.g. if you
-//want to check for the busy flag, you need to set RS=low RW=high before calling this function.
-static uint8_t ReadLCDMemory_Internal()
+#if LCD_USE_DMA_STREAMING
+//Configures TIM3 so that one period is one step of a DMA frame. The DMA channels are set up per frame.
+static void DMA_Init(void)
 {
-	//Do NOT wait until busy flag turns off here. In order to read the busy flag, this function needs to
-	//be called. If this function checks for busy flag as well, we have infinite recursion and eventual
-	//stack overflow.
+	__HAL_RCC_DMA1_CLK_ENABLE();
+	__HAL_RCC_TIM3_CLK_ENABLE();
 
-	ChangeGPIOPortModes(GPIO_MODE_INPUT);
+	//APB1 timers run at twice the bus clock whenever the APB1 prescaler isn't 1.
+	uint32_t timerClock = HAL_RCC_GetPCLK1Freq();
+	if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+	{
+		timerClock *= 2;
+	}
+
+	TIM3->CR1 = 0;
+	TIM3->DIER = 0;
+	TIM3->PSC = (timerClock / 1000000) - 1; //1 us per tick
+	TIM3->ARR = LCD_DMA_STEP_PERIOD_US - 1;
+	//The control port is written in the middle of a step and the data port at the end of it. This way the
+	//data port is stable half a step before EN rises and half a step after it falls, which covers tAS and tH.
+	TIM3->CCR1 = LCD_DMA_STEP_PERIOD_US / 2;
+	TIM3->EGR = TIM_EGR_UG; //Load the prescaler
+	TIM3->SR = 0;
+}
+
+//Returns 1 when the last started transfer is done and the bus can be used by the CPU again.
+static uint8_t PollDMATransfer(void)
+{
+	if (!dmaStreaming)
+	{
+		return 1;
+	}
+	if ((DMA1->ISR & LCD_DMA_TRANSFER_COMPLETE) != LCD_DMA_TRANSFER_COMPLETE)
+	{
+		return 0;
+	}
+
+	TIM3->CR1 = 0;
+	TIM3->DIER = 0;
+	LCD_DMA_DATA_CHANNEL->CCR = 0;
+	LCD_DMA_CONTROL_CHANNEL->CCR = 0;
+	DMA1->IFCR = LCD_DMA_CLEAR_FLAGS;
+	dmaStreaming = 0;
+#if LCD_USE_WRITE_ONLY_MODE
+	//The last instruction was latched a step or so before the end, give it the full time to be safe.
+	readyAtCycle = DWT->CYCCNT + dataWriteCycles;
+#endif
+	return 1;
+}
+
+static void WaitForDMATransfer(void)
+{
+	while (!PollDMATransfer()) { }
+}
+
+static void StartDMATransfer(void)
+{
+	if (dmaStepCount == 0)
+	{
+		return;
+	}
+
+	ChangeGPIOPortModes(GPIO_MODE_OUTPUT_PP);
+
+	LCD_DMA_DATA_CHANNEL->CCR = 0;
+	LCD_DMA_CONTROL_CHANNEL->CCR = 0;
+	DMA1->IFCR = LCD_DMA_CLEAR_FLAGS;
+
+	//Memory to peripheral, 32 bit words, memory address incremented after every request.
+	const uint32_t channelConfig = DMA_CCR_DIR | DMA_CCR_MINC | DMA_CCR_PSIZE_1 | DMA_CCR_MSIZE_1;
+#if !LCD_USE_4BIT_MODE
+	LCD_DMA_DATA_CHANNEL->CPAR = (uint32_t)&LCD_DATA_PORT->BSRR;
+	LCD_DMA_DATA_CHANNEL->CMAR = (uint32_t)dmaDataPortSteps;
+	LCD_DMA_DATA_CHANNEL->CNDTR = dmaStepCount;
+	LCD_DMA_DATA_CHANNEL->CCR = channelConfig | DMA_CCR_EN;
+#endif
+	LCD_DMA_CONTROL_CHANNEL->CPAR = (uint32_t)&LCD_CONTROL_PORT->BSRR;
+	LCD_DMA_CONTROL_CHANNEL->CMAR = (uint32_t)dmaControlPortSteps;
+	LCD_DMA_CONTROL_CHANNEL->CNDTR = dmaStepCount;
+	LCD_DMA_CONTROL_CHANNEL->CCR = channelConfig | DMA_CCR_EN;
+
+	TIM3->CNT = 0;
+	TIM3->SR = 0;
+#if LCD_USE_4BIT_MODE
+	TIM3->DIER = TIM_DIER_CC1DE;
+#else
+	TIM3->DIER = TIM_DIER_UDE | TIM_DIER_CC1DE;
+#endif
+	TIM3->CR1 = TIM_CR1_CEN;
+
+	dmaStreaming = 1;
+	debugStats.dma.stepsStreamed += dmaStepCount;
+}
+
+//Appends one step to the frame. If the buffer is full, the buffered steps are streamed first.
+static void QueueDMAStep(uint32_t dataPortWord, uint32_t controlPortWord)
+{
+	if (dmaStepCount >= LCD_DMA_MAX_STEPS)
+	{
+		uint32_t waitStart = DWT->CYCCNT;
+		StartDMATransfer();
+		WaitForDMATransfer();
+		dmaStepCount = 0;
+		dmaFrameWaitCycles += DWT->CYCCNT - waitStart;
+	}
+#if LCD_USE_4BIT_MODE
+	(void)dataPortWord; //Everything is on the control port
+#else
+	dmaDataPortSteps[dmaStepCount] = dataPortWord;
+#endif
+	dmaControlPortSteps[dmaStepCount] = controlPortWord;
+	dmaStepCount++;
+}
+
+static void QueueBusCycleForDMA(uint16_t busValue)
+{
+	uint32_t dataPortWord = 0, controlPortWord = 0;
+	EncodeBusCycle(busValue, &dataPortWord, &controlPortWord);
+
+	QueueDMAStep(dataPortWord, controlPortWord); //Data setup
+	QueueDMAStep(0, Pin_EN_Pin); //EN high. Writing 0 to BSRR leaves the port as it is.
+	QueueDMAStep(0, (uint32_t)Pin_EN_Pin << 16); //EN low, the chip latches the bus here
+}
+
+static void QueueInstructionForDMA(uint16_t instruction)
+{
+#if LCD_USE_4BIT_MODE
+	QueueBusCycleForDMA(UPPER_NIBBLE_CYCLE(instruction));
+	QueueBusCycleForDMA(LOWER_NIBBLE_CYCLE(instruction));
+#else
+	QueueBusCycleForDMA(instruction);
+#endif
+	CountInstruction(instruction);
+#if LCD_USE_WRITE_ONLY_MODE
+	(void)TrackInstruction(instruction); //Only the address counter matters, the frame has its own timing.
+#endif
+
+	//There is no busy flag to poll in this mode. Clear display and return home take 1.52 ms instead of
+	//37 us, pad them with idle steps so that the next instruction isn't sent too early.
+	if ((instruction & 0b1111111100) == 0)
+	{
+		uint32_t idleSteps = (LCD_DMA_LONG_INSTRUCTION_PERIOD_US + LCD_DMA_STEP_PERIOD_US - 1) / LCD_DMA_STEP_PERIOD_US;
+		for (uint32_t i = LCD_DMA_STEPS_PER_INSTRUCTION; i < idleSteps; i++)
+		{
+			QueueDMAStep(0, 0);
+		}
+	}
+	debugStats.dma.instructionsStreamed++;
+}
+#endif
+
+//Makes sure a DMA frame isn't driving the bus before the CPU accesses it.
+static void WaitForBusAccess(void)
+{
+#if LCD_USE_DMA_STREAMING
+	WaitForDMATransfer();
+#endif
+}
 
+//Does one read cycle on the bus and returns D7-D0 (D7-D4 in the upper 4 bits in 4-bit mode). The data pins need
+//to be inputs and RS/RW need to be set already.
+static uint8_t ReadBusCycle(void)
+{
 	//Here RS and RW are already set. Before enable pin is used, tAS time needs to pass.
 	//In case the caller didn't do it, add the delay here.
-	uint32_t tAS = 1; //This is 40 ns minimum. We have a resolution of us, so wait 1 us.
-	DWT_delay_us(tAS);
+	DelayCycles(TAS_CYCLES);
 
 	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_SET);
-	uint32_t tDDR = 1; //This is 160 ns (max). Since we have 1 us precision, wait for 1 us.
-	DWT_delay_us(tDDR); //Wait until data becomes valid.
-	//NOTE: The enable signal also needs to stay high for at least PWeh = 230 ns. Since we are
-	//waiting 1 us, it includes this delay as well so we don't need to bother with it.
+	uint32_t enableRise = DWT->CYCCNT;
+	DelayCyclesFrom(enableRise, TDDR_CYCLES); //Wait until data becomes valid.
 	uint8_t value = 0;
 	value |= HAL_GPIO_ReadPin(Pin_D7_GPIO_Port, Pin_D7_Pin) << 7;
 	value |= HAL_GPIO_ReadPin(Pin_D6_GPIO_Port, Pin_D6_Pin) << 6;
 	value |= HAL_GPIO_ReadPin(Pin_D5_GPIO_Port, Pin_D5_Pin) << 5;
 	value |= HAL_GPIO_ReadPin(Pin_D4_GPIO_Port, Pin_D4_Pin) << 4;
+#if !LCD_USE_4BIT_MODE
 	value |= HAL_GPIO_ReadPin(Pin_D3_GPIO_Port, Pin_D3_Pin) << 3;
 	value |= HAL_GPIO_ReadPin(Pin_D2_GPIO_Port, Pin_D2_Pin) << 2;
 	value |= HAL_GPIO_ReadPin(Pin_D1_GPIO_Port, Pin_D1_Pin) << 1;
 	value |= HAL_GPIO_ReadPin(Pin_D0_GPIO_Port, Pin_D0_Pin) << 0;
+#endif
 
+	//The enable signal also needs to stay high for at least PWeh, reading the pins probably took that long already.
+	DelayCyclesFrom(enableRise, PWEH_CYCLES);
 	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_RESET);
-	//After enable is set low, the data/address is held for tDHR and tAH respectively. The minimum values of
-	//these are 5ns min and 10ns min. Waiting a whole microsecond is very wasteful, so just wait 100 clock
-	//cycles with NOP.
-	for (int i = 0; i < 100; i++)
-	{
-		__NOP();
-	}
+	DelayCycles(ENABLE_LOW_CYCLES);
+	return value;
+}
+
+//This function expects which read operation needs to be done to already be specified. e.g. if you
+//want to check for the busy flag, you need to set RS=low RW=high before calling this function.
+static uint8_t ReadLCDMemory_Internal()
+{
+	//Do NOT wait until busy flag turns off here. In order to read the busy flag, this function needs to
+	//be called. If this function checks for busy flag as well, we have infinite recursion and eventual
+	//stack overflow.
+
+	ChangeGPIOPortModes(GPIO_MODE_INPUT);
+	uint32_t start = STATS_TIMESTAMP();
+
+#if LCD_USE_4BIT_MODE
+	//The upper nibble comes first, so the busy flag is already in the first cycle. The second cycle still
+	//has to be done, otherwise the chip would be out of step with us.
+	uint8_t value = ReadBusCycle() & 0xF0;
+	value |= ReadBusCycle() >> 4;
+#else
+	uint8_t value = ReadBusCycle();
+#endif
+	STATS_ADD(busReadCycles, STATS_TIMESTAMP() - start);
+
 	ChangeGPIOPortModes(GPIO_MODE_OUTPUT_PP);
 
 	return value;
 }
 
-void SendInstruction(uint16_t instruction)
+//Writes one encoded bus cycle with the port-level fast path. The data pins need to be outputs.
+static void WriteEncodedBusCycle(uint32_t dataPortWord, uint32_t controlPortWord)
+{
+#if !LCD_USE_4BIT_MODE
+	LCD_DATA_PORT->BSRR = dataPortWord;
+#endif
+	LCD_CONTROL_PORT->BSRR = controlPortWord;
+	//After RS and RW are set to desired values, tAS needs to pass before enable pin is set HIGH.
+	DelayCycles(TAS_CYCLES);
+
+	//Toggle enable pin. The data is latched on the falling edge, after at least PWeh.
+	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_SET);
+	DelayCycles(PWEH_CYCLES);
+	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_RESET);
+	DelayCycles(ENABLE_LOW_CYCLES);
+}
+
+#if LCD_USE_4BIT_MODE
+//Only needed for the single nibbles of the 4-bit initialization sequence.
+static void WriteBusCycle(uint16_t busValue)
+{
+	uint32_t dataPortWord = 0, controlPortWord = 0;
+	EncodeBusCycle(busValue, &dataPortWord, &controlPortWord);
+	WriteEncodedBusCycle(dataPortWord, controlPortWord);
+}
+#endif
+
+#if !LCD_USE_WRITE_ONLY_MODE
+static void RecordBusyTimeout(void)
+{
+	debugStats.faults.busyTimeouts++;
+	//Don't wait for long instructions again until the chip responds.
+	nextBusyTimeoutCycles = busyTimeoutCycles;
+	if (++consecutiveTimeouts >= LCD_TIMEOUTS_UNTIL_ABSENT)
+	{
+		if (health != LCD_HEALTH_ABSENT)
+		{
+			debugStats.faults.timesAbsent++;
+		}
+		health = LCD_HEALTH_ABSENT;
+	}
+	else if (health == LCD_HEALTH_OK)
+	{
+		health = LCD_HEALTH_DEGRADED;
+	}
+}
+#endif
+
+//Waits until the chip is done with the last instruction, but never longer than that instruction can take in the
+//worst case. Returns 1 if the chip is ready, 0 if it didn't respond or is known to be absent.
+static uint8_t WaitUntilReady(void)
 {
+	if (health == LCD_HEALTH_ABSENT)
+	{
+		return 0;
+	}
+	uint32_t start = DWT->CYCCNT;
+#if LCD_USE_WRITE_ONLY_MODE
 	while (IsBusy()) { }
+	STATS_ADD(busyWaitCycles, DWT->CYCCNT - start);
+	return 1;
+#else
+	while (IsBusy())
+	{
+		if ((DWT->CYCCNT - start) > nextBusyTimeoutCycles)
+		{
+			RecordBusyTimeout();
+			STATS_ADD(busyWaitCycles, DWT->CYCCNT - start);
+			return 0;
+		}
+	}
+	consecutiveTimeouts = 0;
+	STATS_ADD(busyWaitCycles, DWT->CYCCNT - start);
+	return 1;
+#endif
+}
 
+//Waits for the chip and writes the instruction. The chip doesn't execute anything between the two nibbles of
+//4-bit mode, so the busy flag is only checked once. Nothing is written if the chip doesn't respond.
+static void WriteEncodedInstruction(const EncodedInstruction* encoded, uint16_t instruction)
+{
+	if (!WaitUntilReady())
+	{
+		return;
+	}
+	uint32_t start = STATS_TIMESTAMP();
+	CountInstruction(instruction);
+
+#if !LCD_USE_WRITE_ONLY_MODE
+	//In write-only mode the data pins never become inputs.
 	ChangeGPIOPortModes(GPIO_MODE_OUTPUT_PP);
-	GPIO_TypeDef* ports[] = { Pin_RS_GPIO_Port, Pin_RW_GPIO_Port, Pin_D7_GPIO_Port, Pin_D6_GPIO_Port,
-							  Pin_D5_GPIO_Port, Pin_D4_GPIO_Port, Pin_D3_GPIO_Port, Pin_D2_GPIO_Port,
-							  Pin_D1_GPIO_Port, Pin_D0_GPIO_Port };
+#endif
+	for (int i = 0; i < BUS_CYCLES_PER_INSTRUCTION; i++)
+	{
+		WriteEncodedBusCycle(encoded->dataPortWords[i], encoded->controlPortWords[i]);
+	}
+#if LCD_USE_WRITE_ONLY_MODE
+	//The next instruction can't be sent before this deadline
+	readyAtCycle = DWT->CYCCNT + TrackInstruction(instruction);
+#else
+	//Clear display and return home take much longer than the rest.
+	nextBusyTimeoutCycles = ((instruction & 0b1111111100) == 0) ? longBusyTimeoutCycles : busyTimeoutCycles;
+#endif
+	STATS_ADD(busWriteCycles, STATS_TIMESTAMP() - start);
+}
 
-	uint16_t pins[] 	  = { Pin_RS_Pin, Pin_RW_Pin, Pin_D7_Pin, Pin_D6_Pin, Pin_D5_Pin,
-			                  Pin_D4_Pin, Pin_D3_Pin, Pin_D2_Pin, Pin_D1_Pin, Pin_D0_Pin };
-	for (int i = 0; i < arr_size(pins); i++)
+//Writes the bytes one after the other to wherever the address counter points. The next byte is encoded while the
+//chip executes the current one and the busy flag is polled once per byte.
+static void StreamBytes(const uint8_t* bytes, size_t length)
+{
+	if (length == 0)
 	{
-		HAL_GPIO_WritePin(ports[i], pins[i], (instruction >> ((arr_size(pins) - 1) - i)) & 0x1);
+		return;
 	}
-	//After RS and RW are set to desired values, tAS = 40 ns min needs to pass before enable pin is set HIGH.
-	//Our resolution is in us, so wait 1 us.
-	uint32_t tAS = 1;
-	DWT_delay_us(tAS);
+#if LCD_USE_DMA_STREAMING
+	if (dmaFrameDepth > 0)
+	{
+		for (size_t i = 0; i < length; i++)
+		{
+			QueueInstructionForDMA(0b1000000000 | bytes[i]);
+		}
+		return;
+	}
+#endif
+	WaitForBusAccess();
+	uint32_t start = DWT->CYCCNT;
 
-	//Toggle enable pin
-	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_SET);
-	//After enable pin is set HIGH, tDSW = 80 ns min needs to pass.
-	//Our resolution is in microseconds, so wait 1 us.
-	uint32_t tDSW = 1;
-	DWT_delay_us(tDSW);
-	HAL_GPIO_WritePin(Pin_EN_GPIO_Port, Pin_EN_Pin, GPIO_PIN_RESET);
-	//After enable pin is set LOW, both the address and the data lines are held by the chip
-	//for tAH and tH respectively, both of them are 10 ns min. Waiting 1 microsecond is very wasteful, so
-	//just wait for 100 clock cycles using NOP.
-	for (int i = 0; i < 100; i++)
+	EncodedInstruction current, next;
+	uint16_t currentInstruction = 0b1000000000 | bytes[0];
+	EncodeInstruction(currentInstruction, &current);
+	for (size_t i = 0; i < length; i++)
+	{
+		WriteEncodedInstruction(&current, currentInstruction);
+		if (i + 1 < length)
+		{
+			//The chip is busy with the byte just written, prepare the next one in the meantime.
+			currentInstruction = 0b1000000000 | bytes[i + 1];
+			EncodeInstruction(currentInstruction, &next);
+			current = next;
+		}
+	}
+
+	uint32_t cycles = DWT->CYCCNT - start;
+	debugStats.write.buffersWritten++;
+	debugStats.write.charactersWritten += length;
+	debugStats.write.cycles += cycles;
+	debugStats.write.lastCyclesPerCharacter = cycles / length;
+}
+
+void SendInstruction(uint16_t instruction)
+{
+#if LCD_USE_DMA_STREAMING
+	if (dmaFrameDepth > 0)
 	{
-		__NOP();
+		QueueInstructionForDMA(instruction);
+		return;
 	}
+#endif
+	WaitForBusAccess();
+	EncodedInstruction encoded;
+	EncodeInstruction(instruction, &encoded);
+	WriteEncodedInstruction(&encoded, instruction);
 }
 
 void Init16x2LCD()
@@ -146,13 +715,69 @@ void Init16x2LCD()
 	HAL_Delay(12);
 
 	//Enable this before sending any instructions because instruction sending
-	//relies on microsecond delays, for which DWT needs to be enabled.
-	DWT_Init();
+	//relies on cycle delays, for which DWT needs to be enabled.
+	if (!Delay_Init())
+	{
+		//The bus timings were computed for a slower clock, the chip would see too short pulses.
+		Error_Handler();
+	}
+	health = LCD_HEALTH_OK;
+#if !LCD_USE_WRITE_ONLY_MODE
+	consecutiveTimeouts = 0;
+	busyTimeoutCycles = MicrosecondsToLCDCycles(LCD_DATA_WRITE_TIME_US, LCD_FOSC_MIN_HZ);
+	longBusyTimeoutCycles = MicrosecondsToLCDCycles(LCD_LONG_INSTRUCTION_TIME_US, LCD_FOSC_MIN_HZ);
+	//The chip might still be running its internal reset.
+	nextBusyTimeoutCycles = longBusyTimeoutCycles;
+#endif
+#if LCD_USE_WRITE_ONLY_MODE
+	InitExecutionTimeModel();
+	ChangeGPIOPortModes(GPIO_MODE_OUTPUT_PP);
+#endif
+#if LCD_USE_DMA_STREAMING
+	WaitForDMATransfer();
+	DMA_Init();
+#endif
 
-	FunctionSet(1, 1, 0);
+#if LCD_USE_4BIT_MODE
+	/*
+		The chip might be in 8-bit mode or halfway through a 4-bit instruction, so the busy flag can't be read
+		yet. Initialization by instruction from the datasheet: function set (8-bit) three times with the
+		specified waits, then function set (4-bit) as a single nibble. After that, the chip takes two nibbles
+		per instruction and the busy flag can be checked.
+	*/
+	WaitForBusAccess();
+	ChangeGPIOPortModes(GPIO_MODE_OUTPUT_PP);
+	WriteBusCycle(UPPER_NIBBLE_CYCLE(0b0000110000));
+	HAL_Delay(5); //4.1 ms min
+	WriteBusCycle(UPPER_NIBBLE_CYCLE(0b0000110000));
+	DelayCycles(DELAY_US_TO_CYCLES(100)); //100 us min
+	WriteBusCycle(UPPER_NIBBLE_CYCLE(0b0000110000));
+	DelayCycles(DELAY_US_TO_CYCLES(100));
+	WriteBusCycle(UPPER_NIBBLE_CYCLE(0b0000100000));
+	DelayCycles(DELAY_US_TO_CYCLES(100));
+#endif
+
+	LCD_BeginFrame();
+	FunctionSet(!LCD_USE_4BIT_MODE, 1, 0);
 	DisplayAndCursorControl(1, 0, 0);
 	EntryModeSet(1, 0);
 	ClearScreen();
+	LCD_EndFrame();
+
+#if !LCD_USE_WRITE_ONLY_MODE
+	//Make sure the chip came out of the initialization. If it didn't, don't bother talking to it until the
+	//next LCD_ServiceHealth() retry.
+	WaitForBusAccess();
+	nextBusyTimeoutCycles = longBusyTimeoutCycles;
+	if (!WaitUntilReady())
+	{
+		if (health != LCD_HEALTH_ABSENT)
+		{
+			debugStats.faults.timesAbsent++;
+		}
+		health = LCD_HEALTH_ABSENT;
+	}
+#endif
 }
 
 void ClearScreen()
@@ -209,41 +834,55 @@ void ShiftCursor(uint8_t shiftRight)
 
 void MoveCursor(uint8_t line, uint8_t position)
 {
-	static const uint8_t arr[2] = { FIRST_LINE_START_ADDRESS_IN_DDRAM, SECOND_LINE_START_ADDRESS_IN_DDRAM };
-
 	if (line < 1)
 	{
 		line = 1;
 	}
-	else if (line > 2)
+	else if (line > LCD_ROWS)
 	{
-		line = 2;
+		line = LCD_ROWS;
 	}
 
 	if (position < 1)
 	{
 		position = 1;
 	}
-	else if (position > 40)
+	else if (position > LCD_ROW_LENGTH)
 	{
-		position = 40;
+		position = LCD_ROW_LENGTH;
 	}
 
-	SetDDRAMAddress(arr[line - 1] + position - 1); //Subtract 1 because the addresses start from 0 and the screen lines and rows start from 1.
+	SetDDRAMAddress(LCD_ROW_ADDRESS(line) + position - 1); //Subtract 1 because the addresses start from 0 and the screen lines and rows start from 1.
 }
 
 uint8_t GetCurrentLine()
 {
 	uint8_t ac = ReadAddressCounter();
+	uint8_t line;
+	uint8_t offset;
 	if (ac >= FIRST_LINE_START_ADDRESS_IN_DDRAM && ac <= FIRST_LINE_END_ADDRESS_IN_DDRAM)
 	{
-		return 1;
+		line = 1;
+		offset = ac - FIRST_LINE_START_ADDRESS_IN_DDRAM;
 	}
 	else if (ac >= SECOND_LINE_START_ADDRESS_IN_DDRAM && ac <= SECOND_LINE_END_ADDRESS_IN_DDRAM)
 	{
-		return 2;
+		line = 2;
+		offset = ac - SECOND_LINE_START_ADDRESS_IN_DDRAM;
+	}
+	else
+	{
+		return 255;
 	}
-	return 255;
+#if LCD_ROWS == 4
+	if (offset >= LCD_COLUMNS)
+	{
+		line += 2; //The second half of a DDRAM line is the row below the next one.
+	}
+#else
+	(void)offset;
+#endif
+	return line;
 }
 
 void ShiftDisplay(uint8_t shiftRight)
@@ -295,15 +934,25 @@ void SendByte(uint8_t byte)
 	uint16_t instruction = 0b1000000000;
 	instruction |= byte;
 	SendInstruction(instruction);
-
+#if LCD_USE_DMA_STREAMING
+	if (dmaFrameDepth > 0)
+	{
+		//Queued, the frame's timing already accounts for the address counter update.
+		return;
+	}
+#endif
+#if !LCD_USE_WRITE_ONLY_MODE
 	/*
 	  This function is writing data to CGRAM or DDRAM. This internally updates the RAM address counter.
-	  The update happens tADD us after the busy flag turns off. Wait for the busy flag to turn off and
-	  wait for tADD us so that address counter becomes valid for future instructions.
+	  The update happens tADD after the busy flag turns off. Wait for the busy flag to turn off and
+	  wait for tADD so that address counter becomes valid for future instructions.
+	  In write-only mode the update is part of the execution time model, the next instruction waits for it.
 	*/
-	while (IsBusy()) {}
-	uint32_t tADD = 4;
-	DWT_delay_us(tADD);
+	if (WaitUntilReady())
+	{
+		DelayCycles(TADD_CYCLES);
+	}
+#endif
 }
 
 void WriteCharacter(uint8_t character)
@@ -313,11 +962,24 @@ void WriteCharacter(uint8_t character)
 
 void WriteString(const char* text)
 {
-	size_t len = strlen(text);
-	for (size_t i = 0; i < len; i++)
-	{
-		WriteCharacter(text[i]);
-	}
+	StreamBytes((const uint8_t*)text, strlen(text));
+}
+
+void LCD_WriteBuffer(uint8_t line, uint8_t column, const uint8_t* buffer, size_t length)
+{
+	MoveCursor(line, column);
+	StreamBytes(buffer, length);
+}
+
+void LCD_WriteCGRAM(uint8_t slot, const uint8_t* pattern)
+{
+	SetCGRAMAddress((slot & 0x07) << 3);
+	StreamBytes(pattern, 8);
+}
+
+const LCD_WriteStats* LCD_GetWriteStats(void)
+{
+	return &debugStats.write;
 }
 
 void SetCGRAMAddress(uint8_t address)
@@ -338,38 +1000,209 @@ void SetDDRAMAddress(uint8_t address)
 
 uint8_t IsBusy()
 {
+	WaitForBusAccess();
+#if LCD_USE_WRITE_ONLY_MODE
+	//Nothing can be read back. The chip is busy until the deadline of the last instruction.
+	return (int32_t)(DWT->CYCCNT - readyAtCycle) < 0;
+#else
+	STATS_ADD(busyPolls, 1);
 	//Notify the chip we want to read the busy flag
 	HAL_GPIO_WritePin(Pin_RS_GPIO_Port, Pin_RS_Pin, GPIO_PIN_RESET);
 	HAL_GPIO_WritePin(Pin_RW_GPIO_Port, Pin_RW_Pin, GPIO_PIN_SET);
 	uint8_t data = ReadLCDMemory_Internal();
 	return (data >> 7); //highest bit is the busy flag
+#endif
 }
 
 uint8_t ReadAddressCounter()
 {
+	WaitForBusAccess();
+#if LCD_USE_WRITE_ONLY_MODE
+	return addressesCGRAM ? cgramAddress : ddramAddress;
+#else
+	//Wait until the busy flag turns off
+	if (!WaitUntilReady())
+	{
+		return 0;
+	}
+	DelayCycles(TADD_CYCLES); //Address counter becomes valid tADD after the busy flag turns off
+
+	STATS_ADD(instructionCounts[LCD_INSTRUCTION_ADDRESS_READ], 1);
 	//Notify the chip we want to read the address counter
 	HAL_GPIO_WritePin(Pin_RS_GPIO_Port, Pin_RS_Pin, GPIO_PIN_RESET);
 	HAL_GPIO_WritePin(Pin_RW_GPIO_Port, Pin_RW_Pin, GPIO_PIN_SET);
 
-	//Wait until the busy flag turns off
-	while (IsBusy()) {}
-	uint32_t tADD = 4; //Address counter becomes valid tADD us after the busy flag turns off
-	DWT_delay_us(tADD);
-
 	uint8_t data = ReadLCDMemory_Internal();
 	return data & 0x7F; //All bits except the highest one make up the address
+#endif
 }
 
 uint8_t ReadByte()
 {
+	WaitForBusAccess();
+#if LCD_USE_WRITE_ONLY_MODE
+	//The chip can't be read with RW tied low.
+	return 0;
+#else
+	//Wait until the busy flag turns off. This has to happen before RS is set, reading the busy flag sets RS low.
+	if (!WaitUntilReady())
+	{
+		return 0;
+	}
+	DelayCycles(TADD_CYCLES); //Address counter becomes valid tADD after the busy flag turns off
+
+	STATS_ADD(instructionCounts[LCD_INSTRUCTION_DATA_READ], 1);
 	//Notify the chip we want to read the RAM
 	HAL_GPIO_WritePin(Pin_RS_GPIO_Port, Pin_RS_Pin, GPIO_PIN_SET);
 	HAL_GPIO_WritePin(Pin_RW_GPIO_Port, Pin_RW_Pin, GPIO_PIN_SET);
 
-	//Wait until the busy flag turns off
-	while (IsBusy()) {}
-	uint32_t tADD = 4; //Address counter becomes valid tADD us after the busy flag turns off
-	DWT_delay_us(tADD);
+	uint8_t data = ReadLCDMemory_Internal();
+	//Reading RAM moves the address counter just like writing does.
+	nextBusyTimeoutCycles = busyTimeoutCycles;
+	return data;
+#endif
+}
+
+void LCD_BeginFrame(void)
+{
+	if (statsFrameDepth++ == 0)
+	{
+		statsFrameCharacters = 0;
+	}
+#if LCD_USE_DMA_STREAMING
+	if (dmaFrameDepth++ > 0)
+	{
+		return;
+	}
+	//The buffer might still be streamed from the previous frame.
+	WaitForDMATransfer();
+	dmaStepCount = 0;
+	dmaFrameWaitCycles = 0;
+	dmaFrameStartSteps = debugStats.dma.stepsStreamed;
+	dmaFrameStartCycle = DWT->CYCCNT;
+#endif
+}
+
+void LCD_EndFrame(void)
+{
+	if (statsFrameDepth > 0 && --statsFrameDepth == 0)
+	{
+		debugStats.framesDrawn++;
+		debugStats.charactersInLastFrame = statsFrameCharacters;
+		if (statsFrameCharacters > debugStats.maxCharactersPerFrame)
+		{
+			debugStats.maxCharactersPerFrame = statsFrameCharacters;
+		}
+	}
+#if LCD_USE_DMA_STREAMING
+	if (dmaFrameDepth == 0 || --dmaFrameDepth > 0)
+	{
+		return;
+	}
+#if !LCD_USE_WRITE_ONLY_MODE
+	//The streamed instructions can't be checked, so the chip is checked once before them. A chip that stopped
+	//responding is noticed here, one frame late at most, and goes through the same timeouts as the CPU writes.
+	if (dmaStepCount > 0 && !WaitUntilReady())
+	{
+		dmaStepCount = 0;
+		return;
+	}
+#endif
+	if (health == LCD_HEALTH_ABSENT)
+	{
+		//Nobody to stream to
+		dmaStepCount = 0;
+		return;
+	}
+	StartDMATransfer();
+	dmaStepCount = 0;
+
+	debugStats.dma.framesStreamed++;
+	debugStats.dma.lastFrameSteps = debugStats.dma.stepsStreamed - dmaFrameStartSteps;
+	debugStats.dma.lastFrameCpuCycles = (DWT->CYCCNT - dmaFrameStartCycle) - dmaFrameWaitCycles;
+#endif
+}
+
+uint8_t LCD_IsReady(void)
+{
+	if (LCD_IsStreaming())
+	{
+		return 0;
+	}
+	//In write-only mode this is only a comparison against the deadline, otherwise it costs a busy flag read.
+	return !IsBusy();
+}
+
+uint8_t LCD_IsStreaming(void)
+{
+#if LCD_USE_DMA_STREAMING
+	return !PollDMATransfer();
+#else
+	return 0;
+#endif
+}
+
+#if LCD_USE_DMA_STREAMING
+const LCD_DMAStats* LCD_GetDMAStats(void)
+{
+	return &debugStats.dma;
+}
+#endif
+
+LCD_Health LCD_GetHealth(void)
+{
+	return health;
+}
+
+uint8_t LCD_ServiceHealth(void)
+{
+	if (health == LCD_HEALTH_OK)
+	{
+		return 0;
+	}
 
-	return ReadLCDMemory_Internal();
+	uint32_t now = HAL_GetTick();
+	if ((now - lastReinitAttemptTick) < LCD_REINIT_RETRY_PERIOD_MS)
+	{
+		return 0;
+	}
+	lastReinitAttemptTick = now;
+
+	debugStats.faults.reinitAttempts++;
+	Init16x2LCD();
+	if (health != LCD_HEALTH_OK)
+	{
+		return 0;
+	}
+	debugStats.faults.reinitSuccesses++;
+	return 1;
+}
+
+uint32_t LCD_GetHealthIdleMs(void)
+{
+	if (health == LCD_HEALTH_OK)
+	{
+		return UINT32_MAX;
+	}
+	uint32_t sinceAttempt = HAL_GetTick() - lastReinitAttemptTick;
+	return sinceAttempt >= LCD_REINIT_RETRY_PERIOD_MS ? 0 : LCD_REINIT_RETRY_PERIOD_MS - sinceAttempt;
+}
+
+void LCD_RequestReinit(void)
+{
+	if (health == LCD_HEALTH_OK)
+	{
+		health = LCD_HEALTH_DEGRADED;
+	}
+	lastReinitAttemptTick = HAL_GetTick() - LCD_REINIT_RETRY_PERIOD_MS;
+}
+
+const LCD_FaultStats* LCD_GetFaultStats(void)
+{
+	return &debugStats.faults;
+}
+
+const LCD_DebugStats* LCD_GetDebugStats(void)
+{
+	return &debugStats;
 }
@@ -0,0 +1,301 @@
+/*
+ * lcd_framebuffer.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <lcd_framebuffer.h>
+#include "lcd_HD44780U.h"
+#include "stm32f1xx_hal.h"
+#include <string.h>
+
+//What is being rendered and what each bank of DDRAM currently holds.
+static uint8_t frame[FRAMEBUFFER_LINES][FRAMEBUFFER_COLUMNS];
+static uint8_t shown[FRAMEBUFFER_BANK_COUNT][FRAMEBUFFER_LINES][FRAMEBUFFER_COLUMNS];
+static uint8_t shownIsValid[FRAMEBUFFER_BANK_COUNT] = { 0 };
+//The bank the display is currently shifted to.
+static uint8_t visibleBank = 0;
+//Last position given to Framebuffer_MoveCursor(), line 0 if there is none.
+static uint8_t cursorLine = 0;
+static uint8_t cursorColumn = 0;
+
+static FramebufferStats stats = { 0 };
+
+void Framebuffer_Clear(void)
+{
+	memset(frame, ' ', sizeof(frame));
+}
+
+void Framebuffer_Write(uint8_t line, uint8_t column, const char* text, size_t length)
+{
+	if (line < 1 || line > FRAMEBUFFER_LINES || column < 1 || column > FRAMEBUFFER_COLUMNS)
+	{
+		return;
+	}
+	if (length > (size_t)(FRAMEBUFFER_COLUMNS - column + 1))
+	{
+		length = FRAMEBUFFER_COLUMNS - column + 1;
+	}
+	memcpy(&frame[line - 1][column - 1], text, length);
+}
+
+void Framebuffer_WriteCharacter(uint8_t line, uint8_t column, uint8_t character)
+{
+	Framebuffer_Write(line, column, (const char*)&character, 1);
+}
+
+//Writes the framebuffer into the given bank, only where it differs from what the bank holds.
+static uint32_t FlushToBank(uint8_t bank)
+{
+	uint8_t column0 = bank * FRAMEBUFFER_BANK_OFFSET; //DDRAM column of the first character of the bank
+	uint8_t (*bankShown)[FRAMEBUFFER_COLUMNS] = shown[bank];
+	uint32_t written = 0;
+	uint8_t frameStarted = 0;
+	for (int line = 0; line < FRAMEBUFFER_LINES; line++)
+	{
+		int column = 0;
+		while (column < FRAMEBUFFER_COLUMNS)
+		{
+			if (shownIsValid[bank] && frame[line][column] == bankShown[line][column])
+			{
+				column++;
+				continue;
+			}
+
+			//Found a change, extend the run over the following changes unless the gap between them is too long.
+			int start = column;
+			int lastChanged = column;
+			for (column++; column < FRAMEBUFFER_COLUMNS && column - lastChanged <= FRAMEBUFFER_MERGE_GAP + 1; column++)
+			{
+				if (!shownIsValid[bank] || frame[line][column] != bankShown[line][column])
+				{
+					lastChanged = column;
+				}
+			}
+			int length = lastChanged - start + 1;
+
+			if (!frameStarted)
+			{
+				LCD_BeginFrame();
+				frameStarted = 1;
+			}
+			LCD_WriteBuffer(line + 1, column0 + start + 1, &frame[line][start], length);
+			memcpy(&bankShown[line][start], &frame[line][start], length);
+			written += length;
+			stats.addressSets++;
+			column = lastChanged + 1;
+		}
+	}
+	shownIsValid[bank] = 1;
+
+	if (frameStarted)
+	{
+		LCD_EndFrame();
+		stats.flushes++;
+		stats.charactersWritten += written;
+		stats.lastCharactersWritten = written;
+	}
+	return written;
+}
+
+uint32_t Framebuffer_Flush(void)
+{
+	return FlushToBank(visibleBank);
+}
+
+#if FRAMEBUFFER_USE_DOUBLE_BUFFERING
+uint32_t Framebuffer_FlushHidden(void)
+{
+	return FlushToBank(!visibleBank);
+}
+
+void Framebuffer_Flip(void)
+{
+	if (visibleBank == 0)
+	{
+		//One shift per column streamed back to back. They take less than a millisecond, far shorter than the liquid
+		//crystal needs to react, so the positions in between aren't visible.
+		LCD_BeginFrame();
+		ShiftDisplayLeft(FRAMEBUFFER_BANK_OFFSET);
+		LCD_EndFrame();
+	}
+	else
+	{
+		//A single instruction undoes all the shifts.
+		ReturnHome();
+	}
+	visibleBank = !visibleBank;
+	stats.flips++;
+}
+#endif
+
+void Framebuffer_MoveCursor(uint8_t line, uint8_t column)
+{
+	cursorLine = line;
+	cursorColumn = column;
+	MoveCursor(line, visibleBank * FRAMEBUFFER_BANK_OFFSET + column);
+}
+
+#if FRAMEBUFFER_USE_SCRUBBER
+//Characters the scrubber may read, in thousandths so that slow rates add up.
+static uint32_t scrubAllowanceMilli = 0;
+static uint32_t lastScrubTick = 0;
+//Where the next slice starts.
+static uint8_t scrubBank = 0;
+static uint8_t scrubLine = 0;
+static uint8_t scrubColumn = 0;
+
+//Moves the scrub position to the next slice, skipping banks that aren't known.
+static void AdvanceScrubPosition(uint8_t length)
+{
+	scrubColumn += length;
+	if (scrubColumn < FRAMEBUFFER_COLUMNS)
+	{
+		return;
+	}
+	scrubColumn = 0;
+	if (++scrubLine < FRAMEBUFFER_LINES)
+	{
+		return;
+	}
+	scrubLine = 0;
+	scrubBank = (scrubBank + 1) % FRAMEBUFFER_BANK_COUNT;
+}
+
+uint32_t Framebuffer_GetScrubIdleMs(void)
+{
+	if (LCD_GetHealth() != LCD_HEALTH_OK)
+	{
+		return UINT32_MAX;
+	}
+	//A full slice is waited for even if the next one is shorter, the pace stays the same on average.
+	uint32_t allowanceMilli = scrubAllowanceMilli +
+							  (HAL_GetTick() - lastScrubTick) * FRAMEBUFFER_SCRUB_CHARACTERS_PER_SECOND;
+	uint32_t neededMilli = FRAMEBUFFER_SCRUB_SLICE_LENGTH * 1000u;
+	if (allowanceMilli >= neededMilli)
+	{
+		return 0;
+	}
+	//Rounded up, the slice isn't allowed yet a millisecond earlier.
+	uint32_t missingMilli = neededMilli - allowanceMilli;
+	return (missingMilli + FRAMEBUFFER_SCRUB_CHARACTERS_PER_SECOND - 1) / FRAMEBUFFER_SCRUB_CHARACTERS_PER_SECOND;
+}
+
+void Framebuffer_Scrub(void)
+{
+	uint32_t now = HAL_GetTick();
+	scrubAllowanceMilli += (now - lastScrubTick) * FRAMEBUFFER_SCRUB_CHARACTERS_PER_SECOND;
+	lastScrubTick = now;
+	//Don't save up for more than one slice, the cost is spread evenly.
+	if (scrubAllowanceMilli > FRAMEBUFFER_SCRUB_SLICE_LENGTH * 1000)
+	{
+		scrubAllowanceMilli = FRAMEBUFFER_SCRUB_SLICE_LENGTH * 1000;
+	}
+
+	uint8_t length = FRAMEBUFFER_COLUMNS - scrubColumn;
+	if (length > FRAMEBUFFER_SCRUB_SLICE_LENGTH)
+	{
+		length = FRAMEBUFFER_SCRUB_SLICE_LENGTH;
+	}
+	if (scrubAllowanceMilli < length * 1000u || LCD_GetHealth() != LCD_HEALTH_OK || LCD_IsStreaming())
+	{
+		return;
+	}
+	if (!shownIsValid[scrubBank])
+	{
+		//Nothing to compare against, the next flush writes the whole bank anyway.
+		AdvanceScrubPosition(FRAMEBUFFER_COLUMNS);
+		return;
+	}
+	scrubAllowanceMilli -= length * 1000u;
+
+	uint32_t start = DWT->CYCCNT;
+	const uint8_t* expected = &shown[scrubBank][scrubLine][scrubColumn];
+	uint8_t column = scrubBank * FRAMEBUFFER_BANK_OFFSET + scrubColumn + 1;
+	uint8_t address = LCD_ROW_ADDRESS(scrubLine + 1) + column - 1;
+	uint8_t read[FRAMEBUFFER_SCRUB_SLICE_LENGTH];
+	SetDDRAMAddress(address);
+	for (uint8_t i = 0; i < length; i++)
+	{
+		read[i] = ReadByte();
+	}
+	uint8_t addressCounter = ReadAddressCounter();
+
+	uint8_t wrong = 0;
+	uint8_t spacesRead = 0;
+	uint8_t expectedNonSpaces = 0;
+	for (int i = 0; i < length; i++)
+	{
+		wrong += read[i] != expected[i];
+		spacesRead += read[i] == ' ';
+		expectedNonSpaces += expected[i] != ' ';
+	}
+	stats.scrubbedCharacters += length;
+
+	/*
+	  A reset of the chip (brown-out, ESD) clears DDRAM and puts it back into 8-bit 1 line mode with the display
+	  off. None of that can be read back, but it shows as a slice of spaces where there shouldn't be any. A lost
+	  4-bit nibble or a changed entry mode shows as an address counter that didn't move by one per read.
+	*/
+	uint8_t looksReset = length > 1 && spacesRead == length && expectedNonSpaces >= length / 2;
+	//Reading past the end of a DDRAM line continues at the start of the other one.
+	uint8_t lineStart = address < 0x40 ? 0x00 : 0x40;
+	uint8_t expectedAddress = address + length;
+	if (expectedAddress >= lineStart + LCD_DDRAM_LINE_LENGTH)
+	{
+		expectedAddress = (lineStart ^ 0x40) + (expectedAddress - lineStart - LCD_DDRAM_LINE_LENGTH);
+	}
+	if (addressCounter != expectedAddress || looksReset)
+	{
+		stats.scrubReinits++;
+		LCD_RequestReinit();
+	}
+	else if (wrong > 0)
+	{
+		//Rewrite the wrong characters in runs, merged the same way as in a flush.
+		int i = 0;
+		while (i < length)
+		{
+			if (read[i] == expected[i])
+			{
+				i++;
+				continue;
+			}
+			int runStart = i;
+			int lastWrong = i;
+			for (i++; i < length && i - lastWrong <= FRAMEBUFFER_MERGE_GAP + 1; i++)
+			{
+				if (read[i] != expected[i])
+				{
+					lastWrong = i;
+				}
+			}
+			LCD_WriteBuffer(scrubLine + 1, column + runStart, &expected[runStart], lastWrong - runStart + 1);
+			i = lastWrong + 1;
+		}
+		stats.repairedCharacters += wrong;
+	}
+
+	if (cursorLine != 0)
+	{
+		Framebuffer_MoveCursor(cursorLine, cursorColumn);
+	}
+	stats.lastScrubCycles = DWT->CYCCNT - start;
+	AdvanceScrubPosition(length);
+}
+#endif
+
+void Framebuffer_Invalidate(void)
+{
+	for (int bank = 0; bank < FRAMEBUFFER_BANK_COUNT; bank++)
+	{
+		shownIsValid[bank] = 0;
+	}
+	visibleBank = 0;
+	cursorLine = 0;
+}
+
+const FramebufferStats* Framebuffer_GetStats(void)
+{
+	return &stats;
+}
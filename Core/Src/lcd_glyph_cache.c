@@ -0,0 +1,104 @@
+/*
+ * lcd_glyph_cache.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <lcd_glyph_cache.h>
+#include "lcd_HD44780U.h"
+#include "stm32f1xx_hal.h"
+#include <stddef.h>
+
+#define EMPTY_SLOT		0xFF
+
+static const uint8_t* glyphBitmaps[GLYPH_CACHE_MAX_GLYPHS] = { NULL };
+
+//Which glyph is in each CGRAM slot and when it was last used. Uses are counted, not timed.
+static uint8_t slotGlyphs[GLYPH_CACHE_SLOT_COUNT] = { EMPTY_SLOT, EMPTY_SLOT, EMPTY_SLOT, EMPTY_SLOT,
+													  EMPTY_SLOT, EMPTY_SLOT, EMPTY_SLOT, EMPTY_SLOT };
+static uint32_t slotLastUses[GLYPH_CACHE_SLOT_COUNT] = { 0 };
+static uint32_t useCounter = 0;
+
+//CGRAM can't be trusted after the LCD was re-initialized, it might have lost power.
+static uint32_t knownReinitSuccesses = 0;
+
+static GlyphCacheStats stats = { 0 };
+
+uint8_t Glyph_Register(uint8_t id, const uint8_t* bitmap)
+{
+	if (id >= GLYPH_CACHE_MAX_GLYPHS)
+	{
+		return 0;
+	}
+	glyphBitmaps[id] = bitmap;
+	//If the old bitmap is in CGRAM, it is stale now.
+	for (int slot = 0; slot < GLYPH_CACHE_SLOT_COUNT; slot++)
+	{
+		if (slotGlyphs[slot] == id)
+		{
+			slotGlyphs[slot] = EMPTY_SLOT;
+			slotLastUses[slot] = 0;
+		}
+	}
+	return 1;
+}
+
+uint8_t Glyph_Acquire(uint8_t id)
+{
+	if (id >= GLYPH_CACHE_MAX_GLYPHS || glyphBitmaps[id] == NULL)
+	{
+		return GLYPH_CACHE_UNKNOWN_CHARACTER;
+	}
+	if (LCD_GetFaultStats()->reinitSuccesses != knownReinitSuccesses)
+	{
+		Glyph_InvalidateCache();
+	}
+
+	useCounter++;
+	uint8_t victim = 0;
+	for (int slot = 0; slot < GLYPH_CACHE_SLOT_COUNT; slot++)
+	{
+		if (slotGlyphs[slot] == id)
+		{
+			stats.hits++;
+			slotLastUses[slot] = useCounter;
+			return GLYPH_CACHE_FIRST_CHARACTER + slot;
+		}
+		//Empty slots have never been used, so they are picked before any glyph is evicted.
+		if (slotLastUses[slot] < slotLastUses[victim])
+		{
+			victim = slot;
+		}
+	}
+
+	stats.misses++;
+	if (slotGlyphs[victim] != EMPTY_SLOT)
+	{
+		stats.evictions++;
+	}
+	//Inside a frame this only measures queuing the upload, the bus time is part of the frame.
+	uint32_t start = DWT->CYCCNT;
+	LCD_WriteCGRAM(victim, glyphBitmaps[id]);
+	stats.lastUploadCycles = DWT->CYCCNT - start;
+	stats.uploadCycles += stats.lastUploadCycles;
+
+	slotGlyphs[victim] = id;
+	slotLastUses[victim] = useCounter;
+	return GLYPH_CACHE_FIRST_CHARACTER + victim;
+}
+
+void Glyph_InvalidateCache(void)
+{
+	for (int slot = 0; slot < GLYPH_CACHE_SLOT_COUNT; slot++)
+	{
+		slotGlyphs[slot] = EMPTY_SLOT;
+		slotLastUses[slot] = 0;
+	}
+	useCounter = 0;
+	knownReinitSuccesses = LCD_GetFaultStats()->reinitSuccesses;
+}
+
+const GlyphCacheStats* Glyph_GetCacheStats(void)
+{
+	return &stats;
+}
@@ -0,0 +1,114 @@
+/*
+ * lcd_marquee.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <lcd_marquee.h>
+#include "lcd_framebuffer.h"
+#include "stm32f1xx_hal.h"
+#include <string.h>
+
+static uint8_t fullScreenRunning = 0;
+static uint32_t lastFullScreenStepTick = 0;
+
+static MarqueeStats stats = { 0 };
+
+void Marquee_SetText(Marquee* marquee, const char* text)
+{
+	size_t length = strlen(text);
+	if (length > MARQUEE_MAX_LENGTH)
+	{
+		length = MARQUEE_MAX_LENGTH;
+	}
+	if (length == marquee->length && memcmp(marquee->text, text, length) == 0)
+	{
+		return;
+	}
+	memcpy(marquee->text, text, length);
+	marquee->length = length;
+	marquee->startTick = HAL_GetTick();
+	marquee->lastStep = 0;
+}
+
+uint8_t Marquee_RenderWindow(Marquee* marquee, uint8_t line, uint8_t column, uint8_t width)
+{
+	if (marquee->length <= width)
+	{
+		Framebuffer_Write(line, column, marquee->text, marquee->length);
+		return 0;
+	}
+
+	//The message goes around with a gap after it, like it is written on a loop.
+	uint32_t loopLength = marquee->length + MARQUEE_WINDOW_GAP;
+	uint32_t steps = (HAL_GetTick() - marquee->startTick) / MARQUEE_STEP_PERIOD_MS;
+	uint32_t offset = steps % loopLength;
+	for (uint8_t i = 0; i < width; i++)
+	{
+		uint32_t index = (offset + i) % loopLength;
+		Framebuffer_WriteCharacter(line, column + i, index < marquee->length ? marquee->text[index] : ' ');
+	}
+
+	uint8_t moved = steps != marquee->lastStep;
+	marquee->lastStep = steps;
+	return moved;
+}
+
+void Marquee_RecordWindowStep(uint32_t cycles, uint32_t characters)
+{
+	stats.windowSteps++;
+	stats.lastWindowStepCycles = cycles;
+	stats.lastWindowStepCharacters = characters;
+}
+
+void Marquee_StartFullScreen(uint8_t line, const char* text)
+{
+	uint8_t lines[2][MARQUEE_MAX_LENGTH];
+	memset(lines, ' ', sizeof(lines));
+	size_t length = strlen(text);
+	if (length > MARQUEE_MAX_LENGTH)
+	{
+		length = MARQUEE_MAX_LENGTH;
+	}
+	memcpy(lines[line == 2 ? 1 : 0], text, length);
+
+	//Writing the whole DDRAM takes a while, let it stream. Return home makes the start of the message visible.
+	LCD_BeginFrame();
+	ReturnHome();
+	LCD_WriteBuffer(1, 1, lines[0], MARQUEE_MAX_LENGTH);
+	LCD_WriteBuffer(2, 1, lines[1], MARQUEE_MAX_LENGTH);
+	LCD_EndFrame();
+
+	fullScreenRunning = 1;
+	lastFullScreenStepTick = HAL_GetTick();
+}
+
+void Marquee_ServiceFullScreen(void)
+{
+	if (!fullScreenRunning || (HAL_GetTick() - lastFullScreenStepTick) < MARQUEE_STEP_PERIOD_MS)
+	{
+		return;
+	}
+	lastFullScreenStepTick = HAL_GetTick();
+
+	//The DDRAM line is a loop, shifting past its end brings the start back around.
+	uint32_t start = DWT->CYCCNT;
+	ShiftDisplay(0);
+	stats.lastFullScreenStepCycles = DWT->CYCCNT - start;
+	stats.fullScreenSteps++;
+}
+
+void Marquee_StopFullScreen(void)
+{
+	if (!fullScreenRunning)
+	{
+		return;
+	}
+	fullScreenRunning = 0;
+	ReturnHome();
+}
+
+const MarqueeStats* Marquee_GetStats(void)
+{
+	return &stats;
+}
@@ -24,9 +24,12 @@
 #include "lcd_HD44780U.h"
 #include "display_control.h"
 #include "debounced_button.h"
+#include "button_gesture.h"
 #include "ds3231.h"
+#include "lcd_marquee.h"
+#include "lcd_framebuffer.h"
+#include "field_format.h"
 #include <string.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <editor.h>
 /* USER CODE END Includes */
@@ -38,13 +41,9 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-#define N_BUTTONS_IN_CIRCUIT		5 //Total number of buttons in the circuit to be debounced
-//Indices of the buttons in the debouncable buttons array
-#define ALARM_TOGGLE_BUTTON_INDEX   			0
-#define PAGE_TOGGLE_BUTTON_INDEX 				1
-#define HOUR_FORMAT_CHANGE_BUTTON_INDEX			2
-#define EDIT_CHOICE_BUTTON_INDEX				3
-#define INCREMENT_EDITED_VALUE_BUTTON_INDEX		4
+//Bits of the settings byte kept in the DS3231, see DS3231_REG_ADDR_USER_BYTE.
+#define SETTINGS_12H_FORMAT						(1 << 0)
+#define LOAD_WINDOW_MS							1000
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -57,6 +56,34 @@ I2C_HandleTypeDef hi2c1;
 
 /* USER CODE BEGIN PV */
 static uint8_t currentCentury = 21;
+//The alarm registers only change when this firmware writes them, so they are read again only after a write,
+//or while a page displays them.
+static uint8_t alarmIsStale = 1;
+//Volatile so that these are kept for the debugger. The diagnostics page shows them as well.
+static volatile uint8_t lastCommitTransactions = 0; //I2C transactions the last WriteDispInfoDataIntoDS3231() took
+//Load of the main loop over the last LOAD_WINDOW_MS in hundredths of a percent, measured from the cycles between
+//waking up and going back to sleep. Shown on the diagnostics page, or read it from the debugger like the
+//Get...Stats() of the modules. There is no free UART to print them, and SWO shares PB3 with D4 of the LCD.
+static volatile uint32_t cpuLoadHundredths = 0;
+static uint64_t busyCycles = 0;
+static uint32_t wakeCycle = 0;
+static uint32_t loadWindowStartTick = 0;
+//Set by the SQW interrupt, wakes the main loop up for the new second.
+static volatile uint8_t secondBoundarySeen = 0;
+//Gestures of the buttons. In edit mode the increment and the hour format buttons step the edited value up and down,
+//repeating while held, and a long press of the edit button saves and leaves edit mode. No button uses double clicks,
+//so clicks are reported on release.
+static const ButtonGestureTimings clickTimings = { 0, 0, 0 };
+static const ButtonGestureTimings longPressTimings = { 0, BUTTON_GESTURE_LONG_PRESS_MS, 0 };
+static const ButtonGestureTimings repeatTimings = { 0, BUTTON_GESTURE_LONG_PRESS_MS, BUTTON_GESTURE_REPEAT_PERIOD_MS };
+static GestureButton gestureButtons[] =
+{
+	GESTURE_BUTTON(PAGE_TOGGLE_Pin, &clickTimings),
+	GESTURE_BUTTON(ALARM_TOGGLE_Pin, &clickTimings),
+	GESTURE_BUTTON(HOUR_FORMAT_CHANGE_Pin, &repeatTimings),
+	GESTURE_BUTTON(EDIT_CHOICE_Pin, &longPressTimings),
+	GESTURE_BUTTON(INCREMENT_EDITED_VALUE_Pin, &repeatTimings),
+};
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -129,18 +156,32 @@ static void ResetI2CBus(void)
   function and it will handle the communication error displaying. It also returns the communication result
   back so if you need to do something special in your context, you can still execute your logic as well.
   In order to ensure the error message will be displayed, this function will block all other execution for
-  3000ms.
+  3000ms, unless a button is pressed in the meantime.
 */
 static HAL_StatusTypeDef I2C_ErrorHandler(HAL_StatusTypeDef commResult)
 {
 	if (commResult != HAL_OK)
 	{
-		ClearScreen();
-		MoveCursor(1, 1);
-		char msg[16] = { 0 };
-		snprintf(msg, 16, "I2C err (%d)", commResult);
-		WriteString(msg);
-		HAL_Delay(3000);
+		const char* reason = commResult == HAL_TIMEOUT ? "timed out" : commResult == HAL_BUSY ? "bus busy" : "no answer";
+		char msg[MARQUEE_MAX_LENGTH + 1] = { 0 };
+		//Formatted by hand, snprintf would link newlib's vfprintf for this one message.
+		char* end = Format_Text(msg, "I2C err (");
+		end = Format_Unsigned(end, commResult, 0);
+		end = Format_Text(end, "): DS3231 ");
+		end = Format_Text(end, reason);
+		*end = '\0';
+		//The message doesn't fit in 16 columns, scroll it with the display shift while waiting.
+		Marquee_StartFullScreen(1, msg);
+		uint32_t start = HAL_GetTick();
+		//The buttons are still sampled in the background, a new press ends the message early so it is handled in
+		//time. Events that were queued before, or releases, don't: the message would be skipped right away.
+		uint32_t pressCount = GetButtonPressCount();
+		while ((HAL_GetTick() - start) < 3000 && GetButtonPressCount() == pressCount)
+		{
+			Marquee_ServiceFullScreen();
+		}
+		Marquee_StopFullScreen();
+		ReapplyDisplayedPage(); //The marquee overwrote the screen behind the framebuffer's back
 	}
 	return commResult;
 }
@@ -150,13 +191,14 @@ static void ToggleAlarm(void)
 	uint8_t alarmEnabled = 0;
 	I2C_ErrorHandler(DS3231_IsAlarmEnabled(&alarmEnabled));
 	I2C_ErrorHandler(DS3231_ToggleAlarm(!alarmEnabled));
+	alarmIsStale = 1;
 }
 
-static void ToggleHourFormat(void)
+//The DS3231 keeps counting in 24h format, the format is a setting of the display only.
+static void ToggleHourFormat(DisplayInfo* info)
 {
-	uint8_t currentlyIn12hrFormat = 0;
-	I2C_ErrorHandler(DS3231_Is12hrFormatEnabled(&currentlyIn12hrFormat));
-	I2C_ErrorHandler(DS3231_SetTimeFormat(!currentlyIn12hrFormat));
+	info->displayFormat = (info->displayFormat == DISPLAY_FORMAT_12H) ? DISPLAY_FORMAT_24H : DISPLAY_FORMAT_12H;
+	I2C_ErrorHandler(DS3231_WriteUserByte(info->displayFormat == DISPLAY_FORMAT_12H ? SETTINGS_12H_FORMAT : 0));
 }
 
 static void SetDateForDS3231(uint16_t year, uint8_t month, uint8_t dayOfTheMonth, uint8_t dayOfTheWeek, uint8_t hoursIn24hFormat, uint8_t minutes, uint8_t seconds)
@@ -170,70 +212,201 @@ static void SetDateForDS3231(uint16_t year, uint8_t month, uint8_t dayOfTheMonth
 	I2C_ErrorHandler(DS3231_WriteSeconds(seconds));
 }
 
-static void ReadDS3231DataIntoDisplayInfo(DisplayInfo* info)
+//Reads the DISPLAY_SOURCE_ parts of the info. The other parts keep their last values.
+static void ReadDS3231DataIntoDisplayInfo(DisplayInfo* info, uint8_t sources)
 {
 	//Clock info
-	I2C_ErrorHandler(DS3231_ReadSeconds(&info->seconds));
-	I2C_ErrorHandler(DS3231_ReadMinutes(&info->minutes));
-	I2C_ErrorHandler(DS3231_ReadHours(&info->hours, NULL, NULL));
-	I2C_ErrorHandler(DS3231_IsTimePM(&info->isTimePM));
-	I2C_ErrorHandler(DS3231_Is12hrFormatEnabled(&info->displayFormat));
+	if (sources & DISPLAY_SOURCE_TIME)
+	{
+		I2C_ErrorHandler(DS3231_ReadSeconds(&info->seconds));
+		I2C_ErrorHandler(DS3231_ReadMinutes(&info->minutes));
+		I2C_ErrorHandler(DS3231_ReadHours(&info->hours));
+	}
 
 	//Date info
-	I2C_ErrorHandler(DS3231_ReadDayOfTheWeek(&info->dayOfTheWeek));
-	I2C_ErrorHandler(DS3231_ReadDayOfTheMonth(&info->dayOfTheMonth));
-	I2C_ErrorHandler(DS3231_ReadMonth(&info->month));
-
-	uint8_t centuryPassed = 0;
-	I2C_ErrorHandler(DS3231_ReadCenturyBit(&centuryPassed));
-	if (centuryPassed)
+	if (sources & DISPLAY_SOURCE_DATE)
 	{
-	  currentCentury++;
-	  I2C_ErrorHandler(DS3231_WriteCenturyBit(0)); //Clear the century bit
-	}
+		I2C_ErrorHandler(DS3231_ReadDayOfTheWeek(&info->dayOfTheWeek));
+		I2C_ErrorHandler(DS3231_ReadDayOfTheMonth(&info->dayOfTheMonth));
+		I2C_ErrorHandler(DS3231_ReadMonth(&info->month));
+
+		//The century bit stays set until it is cleared here, so it isn't missed while the date isn't read.
+		uint8_t centuryPassed = 0;
+		I2C_ErrorHandler(DS3231_ReadCenturyBit(&centuryPassed));
+		if (centuryPassed)
+		{
+		  currentCentury++;
+		  I2C_ErrorHandler(DS3231_WriteCenturyBit(0)); //Clear the century bit
+		}
 
-	uint8_t ds3231_yearInfo = 0; //Range is between 00-99
-	I2C_ErrorHandler(DS3231_ReadYear(&ds3231_yearInfo));
-	info->year = ((currentCentury - 1) * 100) + ds3231_yearInfo;
+		uint8_t ds3231_yearInfo = 0; //Range is between 00-99
+		I2C_ErrorHandler(DS3231_ReadYear(&ds3231_yearInfo));
+		info->year = ((currentCentury - 1) * 100) + ds3231_yearInfo;
+	}
 
-	//Alarm info
-	I2C_ErrorHandler(DS3231_IsAlarmEnabled(&info->alarmEnabled));
-	I2C_ErrorHandler(DS3231_ReadAlarmTime(&info->alarmHours, &info->alarmMinutes, &info->alarmDisplayFormat, &info->isAlarmTimePM));
-	I2C_ErrorHandler(DS3231_ReadTemperature(&info->temperature));
+	//Alarm info. alarmEnabled is also needed for sounding the alarm, which is why a stale copy is read on every page.
+	if ((sources & DISPLAY_SOURCE_ALARM) || alarmIsStale)
+	{
+		I2C_ErrorHandler(DS3231_IsAlarmEnabled(&info->alarmEnabled));
+		I2C_ErrorHandler(DS3231_ReadAlarmTime(&info->alarmHours, &info->alarmMinutes));
+		alarmIsStale = 0;
+	}
+	if (sources & DISPLAY_SOURCE_TEMPERATURE)
+	{
+		I2C_ErrorHandler(DS3231_ReadTemperature(&info->temperature));
+	}
 }
 
-static void WriteDispInfoDataIntoDS3231(const DisplayInfo* info)
+/*
+  Writes only the registers whose values are different in info than in previous, the values editing started from.
+  The time keeps running while editing, writing an unchanged field would set it back to where it was.
+*/
+static void WriteDispInfoDataIntoDS3231(const DisplayInfo* previous, const DisplayInfo* info)
 {
-	I2C_ErrorHandler(DS3231_WriteHours(info->hours));
-	I2C_ErrorHandler(DS3231_WriteMinutes(info->minutes));
-	I2C_ErrorHandler(DS3231_WriteSeconds(info->seconds));
-	I2C_ErrorHandler(DS3231_SetTimeFormat(info->displayFormat));
-	I2C_ErrorHandler(DS3231_WriteDayOfTheMonth(info->dayOfTheMonth));
-	I2C_ErrorHandler(DS3231_WriteMonth(info->month));
 	//The last 2 digits of the year are held in DS3231.
 	//The higher 2 digits are based on the century flag and are calculated elsewhere.
-	I2C_ErrorHandler(DS3231_WriteYear(info->year % 100));
-	I2C_ErrorHandler(DS3231_WriteDayOfTheWeek(info->dayOfTheWeek));
-	//TODO: Handle setting AM/PM information
-
-	uint8_t alarmTimeIn24hFormat = 0;
-	if (info->isAlarmTimePM)
+	uint8_t previousTime[DS3231_TIME_REGISTER_COUNT];
+	uint8_t time[DS3231_TIME_REGISTER_COUNT];
+	DS3231_EncodeTimeRegisters(previousTime, previous->hours, previous->minutes, previous->seconds, previous->dayOfTheWeek,
+							   previous->dayOfTheMonth, previous->month, previous->year % 100);
+	DS3231_EncodeTimeRegisters(time, info->hours, info->minutes, info->seconds, info->dayOfTheWeek,
+							   info->dayOfTheMonth, info->month, info->year % 100);
+
+	uint8_t previousAlarm[DS3231_ALARM_REGISTER_COUNT];
+	uint8_t alarm[DS3231_ALARM_REGISTER_COUNT];
+	DS3231_EncodeAlarmRegisters(previousAlarm, previous->alarmHours, previous->alarmMinutes);
+	DS3231_EncodeAlarmRegisters(alarm, info->alarmHours, info->alarmMinutes);
+
+	uint8_t transactions = 0;
+	//Bit 7 of the month register is the century bit, which the encoding leaves 0. It is read and kept, like
+	//DS3231_WriteMonth() does. If it can't be read, the month isn't written.
+	const uint8_t monthIndex = DS3231_REG_ADDR_MONTH_AND_CENTURY - DS3231_REG_ADDR_SECONDS;
+	if (time[monthIndex] != previousTime[monthIndex])
 	{
-		if (info->alarmHours != 12)
+		uint8_t century = 0;
+		transactions++;
+		if (I2C_ErrorHandler(DS3231_ReadCenturyBit(&century)) == HAL_OK)
+		{
+			time[monthIndex] |= century ? 0x80 : 0;
+			previousTime[monthIndex] |= century ? 0x80 : 0;
+		}
+		else
 		{
-			alarmTimeIn24hFormat = info->alarmHours + 12;
+			time[monthIndex] = previousTime[monthIndex];
 		}
 	}
+	I2C_ErrorHandler(DS3231_WriteChangedRegisters(DS3231_REG_ADDR_SECONDS, previousTime, time, DS3231_TIME_REGISTER_COUNT, &transactions));
+	I2C_ErrorHandler(DS3231_WriteChangedRegisters(DS3231_REG_ADDR_ALARM2_MINS, previousAlarm, alarm, DS3231_ALARM_REGISTER_COUNT, &transactions));
+	if (info->alarmEnabled != previous->alarmEnabled)
+	{
+		I2C_ErrorHandler(DS3231_ToggleAlarm(info->alarmEnabled));
+		transactions += 2; //Read-modify-write of the control register
+	}
+	if (transactions != 0)
+	{
+		alarmIsStale = 1;
+	}
+	lastCommitTransactions = transactions;
+}
+
+//Steps the edited value up (step = 1) or down (step = -1), the century follows the year.
+static void StepEditedValue(DisplayInfo* info, int8_t step)
+{
+	uint16_t yearBeforeEdit = info->year;
+	if (step > 0)
+	{
+		IncrementCurrentlyEditedValue(info);
+	}
 	else
 	{
-		if (info->alarmHours == 12)
+		DecrementCurrentlyEditedValue(info);
+	}
+	uint16_t yearAfterEdit = info->year;
+	uint8_t highestTwoDigitsBeforeEdit = (yearBeforeEdit - (yearBeforeEdit % 100)) / 100;
+	uint8_t highestTwoDigitsAfterEdit = (yearAfterEdit - (yearAfterEdit % 100)) / 100;
+	if (highestTwoDigitsBeforeEdit != highestTwoDigitsAfterEdit)
+	{
+		//User moved the time into another century.
+		currentCentury += step;
+	}
+}
+
+//Updates cpuLoadHundredths and the values on the diagnostics page once every LOAD_WINDOW_MS.
+static void UpdateLoadMeasurement(void)
+{
+	//The cycle counter may stop while the core sleeps, the window is measured in ticks instead.
+	uint32_t windowMs = HAL_GetTick() - loadWindowStartTick;
+	if (windowMs < LOAD_WINDOW_MS)
+	{
+		return;
+	}
+	uint64_t windowCycles = (uint64_t)windowMs * (SystemCoreClock / 1000);
+	cpuLoadHundredths = (uint32_t)(busyCycles * 10000 / windowCycles);
+	busyCycles = 0;
+	loadWindowStartTick += windowMs;
+
+	const EditorStats* editorStats = GetEditorStats();
+	DisplayDiagnostics diagnostics = { cpuLoadHundredths, editorStats->lastIncrementCycles,
+									   editorStats->lastIncrementCharacters, lastCommitTransactions };
+	SetDisplayDiagnostics(&diagnostics);
+}
+
+//Milliseconds until a timeout of the main loop expires. The button events and the second boundaries aren't included.
+static uint32_t GetLoopIdleMs(uint8_t inEditMode)
+{
+	//The alarm is read back outside edit mode only, so a toggle while editing waits until it ends.
+	if (alarmIsStale && !inEditMode)
+	{
+		return 0;
+	}
+	uint32_t idleMs = GetButtonGestureIdleMs(gestureButtons, sizeof(gestureButtons) / sizeof(gestureButtons[0]));
+	uint32_t healthIdleMs = LCD_GetHealthIdleMs();
+	if (healthIdleMs < idleMs)
+	{
+		idleMs = healthIdleMs;
+	}
+#if FRAMEBUFFER_USE_SCRUBBER
+	uint32_t scrubIdleMs = Framebuffer_GetScrubIdleMs();
+	if (scrubIdleMs < idleMs)
+	{
+		idleMs = scrubIdleMs;
+	}
+#endif
+	//The display isn't updated on its own while editing, only when the edited value changes.
+	if (!inEditMode)
+	{
+		uint32_t displayIdleMs = GetDisplayIdleMs();
+		if (displayIdleMs < idleMs)
 		{
-			alarmTimeIn24hFormat = 0;
+			idleMs = displayIdleMs;
 		}
 	}
+	return idleMs;
+}
 
-	I2C_ErrorHandler(DS3231_SetAlarmTime(info->alarmDisplayFormat == DISPLAY_FORMAT_12H ? alarmTimeIn24hFormat : info->alarmHours, info->alarmMinutes));
-	I2C_ErrorHandler(DS3231_ToggleAlarm(info->alarmEnabled));
+/*
+  Sleeps until the main loop has something to do: a button event, the SQW edge if wakeOnSecondBoundary is set, or
+  idleMs passing. SysTick still wakes the core up every millisecond, those wake ups only check these and go back to
+  sleep instead of running the whole loop. The interrupts are masked around WFI, so one that arrives after the check
+  still wakes it up. It is handled right after, and its time counts as busy.
+*/
+static void SleepUntilWorkIsDue(uint32_t idleMs, uint8_t wakeOnSecondBoundary)
+{
+	uint32_t sleepStartTick = HAL_GetTick();
+	__disable_irq();
+	busyCycles += DWT->CYCCNT - wakeCycle;
+	while (!HasButtonEvents() && !(wakeOnSecondBoundary && secondBoundarySeen) &&
+		   (HAL_GetTick() - sleepStartTick) < idleMs)
+	{
+		__WFI();
+		wakeCycle = DWT->CYCCNT;
+		__enable_irq(); //The interrupt that woke the core up runs here.
+		__disable_irq();
+		busyCycles += DWT->CYCCNT - wakeCycle;
+	}
+	secondBoundarySeen = 0;
+	wakeCycle = DWT->CYCCNT;
+	__enable_irq();
 }
 /* USER CODE END PFP */
 
@@ -250,12 +423,13 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
-  DebouncedButton buttons[N_BUTTONS_IN_CIRCUIT] = { 0 };
-  buttons[ALARM_TOGGLE_BUTTON_INDEX] = InitButtonWithDefaults(ALARM_TOGGLE_GPIO_Port, ALARM_TOGGLE_Pin, GPIO_PIN_SET);
-  buttons[PAGE_TOGGLE_BUTTON_INDEX] = InitButtonWithDefaults(PAGE_TOGGLE_GPIO_Port, PAGE_TOGGLE_Pin, GPIO_PIN_SET);
-  buttons[HOUR_FORMAT_CHANGE_BUTTON_INDEX] = InitButtonWithDefaults(HOUR_FORMAT_CHANGE_GPIO_Port, HOUR_FORMAT_CHANGE_Pin, GPIO_PIN_SET);
-  buttons[EDIT_CHOICE_BUTTON_INDEX] = InitButtonWithDefaults(EDIT_CHOICE_GPIO_Port, EDIT_CHOICE_Pin, GPIO_PIN_SET);
-  buttons[INCREMENT_EDITED_VALUE_BUTTON_INDEX] = InitButtonWithDefaults(INCREMENT_EDITED_VALUE_GPIO_Port, INCREMENT_EDITED_VALUE_Pin, GPIO_PIN_SET);
+  //The buttons are sampled from the SysTick interrupt after their EXTI edges, the main loop gets their gestures
+  //from the events, see gestureButtons.
+  InitButtonWithDefaults(ALARM_TOGGLE_GPIO_Port, ALARM_TOGGLE_Pin, GPIO_PIN_SET);
+  InitButtonWithDefaults(PAGE_TOGGLE_GPIO_Port, PAGE_TOGGLE_Pin, GPIO_PIN_SET);
+  InitButtonWithDefaults(HOUR_FORMAT_CHANGE_GPIO_Port, HOUR_FORMAT_CHANGE_Pin, GPIO_PIN_SET);
+  InitButtonWithDefaults(EDIT_CHOICE_GPIO_Port, EDIT_CHOICE_Pin, GPIO_PIN_SET);
+  InitButtonWithDefaults(INCREMENT_EDITED_VALUE_GPIO_Port, INCREMENT_EDITED_VALUE_Pin, GPIO_PIN_SET);
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -282,19 +456,34 @@ int main(void)
   HAL_StatusTypeDef status = DS3231_Init(&hi2c1);
   if (status != HAL_OK)
   {
+    LCD_BeginFrame();
     ClearScreen();
     MoveCursor(1, 1);
     WriteString("Init error (");
     WriteCharacter('0' + status);
     WriteCharacter(')');
+    LCD_EndFrame();
+    while (LCD_IsStreaming()) { }
     return 1;
   }
   DisplayInfo dispInfo = { 0 };
   dispInfo.tempUnit = TEMP_UNIT_CELSIUS;
+  uint8_t settings = 0;
+  I2C_ErrorHandler(DS3231_ReadUserByte(&settings));
+  dispInfo.displayFormat = (settings & SETTINGS_12H_FORMAT) ? DISPLAY_FORMAT_12H : DISPLAY_FORMAT_24H;
   SetDateForDS3231(2026, 1, 29, 4, 23, 30, 55);
-  I2C_ErrorHandler(DS3231_SetTimeFormat(0));
   I2C_ErrorHandler(DS3231_SetAlarmTime(23, 31));
   I2C_ErrorHandler(DS3231_ToggleAlarm(1));
+  //The display flips to the next second's frame on the edges of the square wave.
+  //This clears INTCN, so the alarm no longer drives INT/SQW low. Nothing waits for that interrupt, the alarm flag
+  //is polled with DS3231_IsAlarmTime() in the main loop.
+  I2C_ErrorHandler(DS3231_EnableSquareWave1Hz());
+#ifdef DEBUG
+  //Keeps the debugger connected while the core sleeps in WFI.
+  HAL_DBGMCU_EnableDBGSleepMode();
+#endif
+  loadWindowStartTick = HAL_GetTick();
+  wakeCycle = DWT->CYCCNT;
 
   /* USER CODE END 2 */
 
@@ -303,82 +492,123 @@ int main(void)
   while (1)
   {
 	  static uint8_t inEditMode = 0;
-	  if (inEditMode)
-	  {
-		  HandleDisplayDuringEditing(&dispInfo);
-	  }
-	  else
+	  UpdateLoadMeasurement();
+	  //Every LCD access gives up quickly while the LCD is faulty, so timekeeping and the alarm below keep
+	  //running. Re-initialization is retried from here.
+	  if (LCD_ServiceHealth())
 	  {
-		  ReadDS3231DataIntoDisplayInfo(&dispInfo);
-		  DisplayTime(&dispInfo);
-
-		  uint8_t isAlarmTime = 0;
-		  I2C_ErrorHandler(DS3231_IsAlarmTime(&isAlarmTime));
-		  if (isAlarmTime)
-		  {
-			  //Sound the alarm if alarm is enabled, stop it (even mid-alarm) if disabled
-			  HAL_GPIO_WritePin(ALARM_SOUND_GPIO_Port, ALARM_SOUND_Pin, dispInfo.alarmEnabled);
-		  }
-		  else
+		  ReapplyDisplayedPage();
+		  if (inEditMode)
 		  {
-			  //Disable the alarm whether or not the alarm is enabled if the alarm time
-			  //has passed/did not come yet
-			  HAL_GPIO_WritePin(ALARM_SOUND_GPIO_Port, ALARM_SOUND_Pin, GPIO_PIN_RESET);
-			  DS3231_SignalAlarmTimePassed();
+			  DisplayTime(&dispInfo);
+			  DisplayAndCursorControl(1, 0, 1);
 		  }
 	  }
 
-	  if (GetDebouncedButtonState(buttons + PAGE_TOGGLE_BUTTON_INDEX) == BUTTON_STATE_PRESSED)
-	  {
-		  SignalDisplayToggle();
-	  }
-
-	  if (GetDebouncedButtonState(buttons + ALARM_TOGGLE_BUTTON_INDEX) == BUTTON_STATE_PRESSED)
-	  {
-		  ToggleAlarm();
-	  }
-
-	  if (GetDebouncedButtonState(buttons + HOUR_FORMAT_CHANGE_BUTTON_INDEX) == BUTTON_STATE_PRESSED)
+	  if (inEditMode)
 	  {
-		  ToggleHourFormat();
+		  HandleDisplayDuringEditing(&dispInfo);
 	  }
-
-	  if (GetDebouncedButtonState(buttons + EDIT_CHOICE_BUTTON_INDEX) == BUTTON_STATE_PRESSED)
+	  else
 	  {
-		  if (!inEditMode)
+		  //The DS3231 only changes at the second boundaries, so it is read once per SQW edge instead of on every
+		  //pass. DisplayTime() runs on every pass, the loop wakes up for the refresh periods of the pages and the
+		  //pre-rendering as well, see GetDisplayIdleMs(). The frame of the new second is flipped in before the read,
+		  //the I2C transfer would delay it otherwise. The next second is pre-rendered after the read.
+		  FlipToNextSecond(&dispInfo);
+		  uint8_t readDS3231 = ShouldReadDisplayInfo() || alarmIsStale;
+		  if (readDS3231)
 		  {
-			  //Get into edit mode
-			  inEditMode = 1;
-			  StartEditing();
+			  ReadDS3231DataIntoDisplayInfo(&dispInfo, GetDisplaySources());
 		  }
-		  else
+		  DisplayTime(&dispInfo);
+
+		  if (readDS3231)
 		  {
-			  uint8_t editingDone = SwitchNextToEdit();
-			  if (editingDone)
+			  uint8_t isAlarmTime = 0;
+			  I2C_ErrorHandler(DS3231_IsAlarmTime(&isAlarmTime));
+			  if (isAlarmTime)
+			  {
+				  //Sound the alarm if alarm is enabled, stop it (even mid-alarm) if disabled
+				  HAL_GPIO_WritePin(ALARM_SOUND_GPIO_Port, ALARM_SOUND_Pin, dispInfo.alarmEnabled);
+			  }
+			  else
 			  {
-				  inEditMode = 0;
-				  EndEditing();
-				  WriteDispInfoDataIntoDS3231(&dispInfo);
+				  //Disable the alarm whether or not the alarm is enabled if the alarm time
+				  //has passed/did not come yet
+				  HAL_GPIO_WritePin(ALARM_SOUND_GPIO_Port, ALARM_SOUND_Pin, GPIO_PIN_RESET);
+				  DS3231_SignalAlarmTimePassed();
 			  }
 		  }
 	  }
-
-	  if (GetDebouncedButtonState(buttons + INCREMENT_EDITED_VALUE_BUTTON_INDEX) == BUTTON_STATE_PRESSED)
+#if FRAMEBUFFER_USE_SCRUBBER
+	  //Lowest priority, repairs DDRAM corruption that the incremental redraws would never touch again.
+	  Framebuffer_Scrub();
+#endif
+
+	  //Handle the gestures recognized from the events queued by the SysTick interrupt, in the order they happened.
+	  ButtonGesture gesture;
+	  uint8_t handledGestures = 0;
+	  while (PopButtonGesture(gestureButtons, sizeof(gestureButtons) / sizeof(gestureButtons[0]), &gesture))
 	  {
-		  if (inEditMode)
+		  handledGestures = 1;
+		  uint8_t isClick = gesture.type == BUTTON_GESTURE_CLICK;
+		  switch (gesture.gpioPin)
 		  {
-			  uint16_t yearBeforeEdit = dispInfo.year;
-			  IncrementCurrentlyEditedValue(&dispInfo);
-			  uint16_t yearAfterEdit = dispInfo.year;
-			  uint8_t highestTwoDigitsBeforeEdit = (yearBeforeEdit - (yearBeforeEdit % 100)) / 100;
-			  uint8_t highestTwoDigitsAfterEdit = (yearAfterEdit - (yearAfterEdit % 100)) / 100;
-			  if (highestTwoDigitsBeforeEdit != highestTwoDigitsAfterEdit)
+		  case PAGE_TOGGLE_Pin:
+			  SignalDisplayToggle();
+			  break;
+		  case ALARM_TOGGLE_Pin:
+			  ToggleAlarm();
+			  break;
+		  case HOUR_FORMAT_CHANGE_Pin:
+			  if (inEditMode)
+			  {
+				  //The hour format isn't changed while editing, the button steps the edited value down instead.
+				  StepEditedValue(&dispInfo, -1);
+			  }
+			  else if (isClick)
+			  {
+				  ToggleHourFormat(&dispInfo);
+			  }
+			  break;
+		  case EDIT_CHOICE_Pin:
+			  if (!inEditMode)
 			  {
-				  //User forwarded time more than a century.
-				  currentCentury++;
+				  if (isClick)
+				  {
+					  //Get into edit mode. The values that differ from these at the end are written back, so all of
+					  //them have to be current.
+					  ReadDS3231DataIntoDisplayInfo(&dispInfo, DISPLAY_SOURCE_ALL);
+					  inEditMode = 1;
+					  StartEditing(&dispInfo);
+				  }
 			  }
+			  else
+			  {
+				  //A long press saves right away, without going through the rest of the values.
+				  uint8_t editingDone = !isClick || SwitchNextToEdit();
+				  if (editingDone)
+				  {
+					  inEditMode = 0;
+					  EndEditing();
+					  WriteDispInfoDataIntoDS3231(GetInfoBeforeEditing(), &dispInfo);
+				  }
+			  }
+			  break;
+		  case INCREMENT_EDITED_VALUE_Pin:
+			  if (inEditMode)
+			  {
+				  StepEditedValue(&dispInfo, 1);
+			  }
+			  break;
+		  default:
+			  break;
 		  }
 	  }
+
+	  //A gesture may have changed what is displayed, the next pass draws it without waiting.
+	  SleepUntilWorkIsDue(handledGestures ? 0 : GetLoopIdleMs(inEditMode), !inEditMode);
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
@@ -493,7 +723,7 @@ static void MX_GPIO_Init(void)
                            INCREMENT_EDITED_VALUE_Pin */
   GPIO_InitStruct.Pin = PAGE_TOGGLE_Pin|ALARM_TOGGLE_Pin|HOUR_FORMAT_CHANGE_Pin|EDIT_CHOICE_Pin
                           |INCREMENT_EDITED_VALUE_Pin;
-  GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING_FALLING;
   GPIO_InitStruct.Pull = GPIO_PULLDOWN;
   HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
@@ -523,12 +753,46 @@ static void MX_GPIO_Init(void)
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
+  /* EXTI interrupt init*/
+  HAL_NVIC_SetPriority(EXTI0_IRQn, 15, 0);
+  HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+
+  HAL_NVIC_SetPriority(EXTI1_IRQn, 15, 0);
+  HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+
+  HAL_NVIC_SetPriority(EXTI2_IRQn, 15, 0);
+  HAL_NVIC_EnableIRQ(EXTI2_IRQn);
+
+  HAL_NVIC_SetPriority(EXTI3_IRQn, 15, 0);
+  HAL_NVIC_EnableIRQ(EXTI3_IRQn);
+
+  HAL_NVIC_SetPriority(EXTI4_IRQn, 15, 0);
+  HAL_NVIC_EnableIRQ(EXTI4_IRQn);
+
   /* USER CODE BEGIN MX_GPIO_Init_2 */
+  GPIO_InitStruct.Pin = SQW_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+  GPIO_InitStruct.Pull = GPIO_PULLUP;
+  HAL_GPIO_Init(SQW_GPIO_Port, &GPIO_InitStruct);
+  HAL_NVIC_SetPriority(SQW_EXTI_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(SQW_EXTI_IRQn);
 
   /* USER CODE END MX_GPIO_Init_2 */
 }
 
 /* USER CODE BEGIN 4 */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	if (GPIO_Pin == SQW_Pin)
+	{
+		SignalSecondBoundary();
+		secondBoundarySeen = 1;
+	}
+	else
+	{
+		SignalButtonEdgeFromISR(GPIO_Pin);
+	}
+}
 
 /* USER CODE END 4 */
 
@@ -0,0 +1,61 @@
+/*
+ * lcd_stub.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+//The LCD driver as seen by the display modules in the host tests. Writes land in hostDDRAM.
+
+#include "lcd_stub.h"
+#include <string.h>
+
+DWT_Type hostDWT;
+char hostDDRAM[LCD_STUB_LINES][LCD_STUB_LINE_LENGTH];
+uint32_t hostDDRAMBank = 0;
+uint32_t hostCharactersWritten = 0;
+
+static uint32_t tick = 0;
+static LCD_DebugStats debugStats;
+
+uint32_t HAL_GetTick(void)
+{
+	return tick;
+}
+
+void HostTick_Set(uint32_t newTick)
+{
+	tick = newTick;
+}
+
+void LCD_WriteBuffer(uint8_t line, uint8_t column, const uint8_t* buffer, size_t length)
+{
+	hostCharactersWritten += length;
+	memcpy(&hostDDRAM[line - 1][column - 1], buffer, length);
+}
+
+void LCD_BeginFrame(void) { }
+void LCD_EndFrame(void) { }
+void MoveCursor(uint8_t line, uint8_t column) { }
+void LCD_WriteCGRAM(uint8_t slot, const uint8_t* pattern) { }
+void ShiftDisplay(uint8_t direction) { }
+
+//The double buffer flips by shifting the second bank into view and returning home.
+void ShiftDisplayLeft(size_t count)
+{
+	hostDDRAMBank = 1;
+}
+
+void ReturnHome(void)
+{
+	hostDDRAMBank = 0;
+}
+
+const LCD_DebugStats* LCD_GetDebugStats(void)
+{
+	return &debugStats;
+}
+
+const LCD_FaultStats* LCD_GetFaultStats(void)
+{
+	return &debugStats.faults;
+}
@@ -0,0 +1,21 @@
+/*
+ * lcd_stub.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef TESTS_STUBS_LCD_STUB_H_
+#define TESTS_STUBS_LCD_STUB_H_
+
+#include "stm32f1xx_hal.h"
+#include "lcd_HD44780U.h"
+
+#define LCD_STUB_LINES				2
+#define LCD_STUB_LINE_LENGTH		40
+
+//What the display modules wrote, and which half of the DDRAM lines is shifted into view.
+extern char hostDDRAM[LCD_STUB_LINES][LCD_STUB_LINE_LENGTH];
+extern uint32_t hostDDRAMBank;
+extern uint32_t hostCharactersWritten;
+
+#endif /* TESTS_STUBS_LCD_STUB_H_ */
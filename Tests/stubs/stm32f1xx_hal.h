@@ -0,0 +1,58 @@
+/*
+ * stm32f1xx_hal.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+//Stands in for the HAL in the host tests. Only what the display modules use is here.
+
+#ifndef TESTS_STUBS_STM32F1XX_HAL_H_
+#define TESTS_STUBS_STM32F1XX_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct
+{
+	volatile uint32_t CYCCNT;
+} DWT_Type;
+
+extern DWT_Type hostDWT;
+#define DWT (&hostDWT)
+
+//The tests move the tick count with HostTick_Set().
+uint32_t HAL_GetTick(void);
+void HostTick_Set(uint32_t tick);
+
+static inline uint32_t HAL_RCC_GetHCLKFreq(void)
+{
+	return 8000000;
+}
+
+typedef struct
+{
+	volatile uint32_t IDR;
+} GPIO_TypeDef;
+
+typedef enum
+{
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET,
+} GPIO_PinState;
+
+#define assert_param(expr)	((void)0)
+
+//There are no interrupts on the host, the tests call the handlers themselves.
+static inline uint32_t __get_PRIMASK(void)
+{
+	return 0;
+}
+
+static inline void __set_PRIMASK(uint32_t primask)
+{
+	(void)primask;
+}
+
+static inline void __disable_irq(void) { }
+
+#endif /* TESTS_STUBS_STM32F1XX_HAL_H_ */
@@ -0,0 +1,130 @@
+/*
+ * test_button_gestures.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+//Tells clicks from double clicks, on time and when the main loop only gets to the events late. A second button
+//without double clicks has to report its clicks right on release.
+
+#include "stm32f1xx_hal.h"
+#include "button_gesture.h"
+#include <stdio.h>
+
+#define DOUBLE_CLICK_PIN	(1 << 0)
+#define CLICK_PIN			(1 << 1)
+#define PRESS_MS			60
+#define GAP_MS				100 //Between the clicks of a double click, well inside BUTTON_GESTURE_DOUBLE_CLICK_MS
+#define SETTLE_MS			1000 //Longer than any timeout, the gestures are all reported after it
+//The debounced events come a few samples after the edges.
+#define MAX_EVENT_LATENCY_MS	(BUTTON_BANK_STABLE_SAMPLES * BUTTON_BANK_SAMPLE_PERIOD_MS)
+
+static const ButtonGestureTimings doubleClickTimings = { BUTTON_GESTURE_DOUBLE_CLICK_MS, 0, 0 };
+static const ButtonGestureTimings clickTimings = { 0, 0, 0 };
+static GestureButton buttons[] =
+{
+	GESTURE_BUTTON(DOUBLE_CLICK_PIN, &doubleClickTimings),
+	GESTURE_BUTTON(CLICK_PIN, &clickTimings),
+};
+
+static GPIO_TypeDef hostPort;
+static uint32_t tick = 0;
+static uint32_t gestureCounts[BUTTON_GESTURE_REPEAT + 1];
+static uint32_t lastGestureDelay = 0; //From the release that was last driven to the last gesture
+static uint32_t lastReleaseTick = 0;
+
+//Pops the gestures like the main loop does and counts them.
+static void PollGestures(void)
+{
+	ButtonGesture gesture;
+	while (PopButtonGesture(buttons, sizeof(buttons) / sizeof(buttons[0]), &gesture))
+	{
+		gestureCounts[gesture.type]++;
+		lastGestureDelay = tick - lastReleaseTick;
+	}
+}
+
+//Holds pins pressed for ms milliseconds, sampling them from the simulated SysTick. Polls the gestures every
+//millisecond if poll is set, otherwise the events wait in the queue.
+static void Hold(uint16_t pins, uint32_t ms, uint8_t poll)
+{
+	for (uint32_t i = 0; i < ms; i++)
+	{
+		HostTick_Set(++tick);
+		if (pins != hostPort.IDR)
+		{
+			SignalButtonEdgeFromISR(pins ^ hostPort.IDR);
+			hostPort.IDR = pins;
+		}
+		SampleDebouncedButtonsFromISR();
+		if (poll)
+		{
+			PollGestures();
+		}
+	}
+}
+
+static void Click(uint16_t pin, uint8_t poll)
+{
+	Hold(pin, PRESS_MS, poll);
+	lastReleaseTick = tick + 1;
+	Hold(0, 1, poll);
+}
+
+/*
+  Runs clicks clicks of pin with gapMs between them, then settles and checks the counted gestures. If poll isn't set,
+  the gestures are only popped SETTLE_MS after the clicks. Returns 1 if they were as expected.
+*/
+static uint8_t RunCase(const char* name, uint16_t pin, uint8_t clicks, uint32_t gapMs, uint8_t poll,
+					   uint32_t expectedClicks, uint32_t expectedDoubleClicks, uint32_t maxDelayMs)
+{
+	for (uint8_t i = 0; i <= BUTTON_GESTURE_REPEAT; i++)
+	{
+		gestureCounts[i] = 0;
+	}
+	for (uint8_t i = 0; i < clicks; i++)
+	{
+		Click(pin, poll);
+		Hold(0, gapMs, poll);
+	}
+	if (!poll)
+	{
+		Hold(0, SETTLE_MS, 0); //Busy until long after the double click time
+	}
+	Hold(0, SETTLE_MS, 1);
+
+	uint32_t others = gestureCounts[BUTTON_GESTURE_LONG_PRESS] + gestureCounts[BUTTON_GESTURE_REPEAT];
+	uint8_t passed = gestureCounts[BUTTON_GESTURE_CLICK] == expectedClicks &&
+					 gestureCounts[BUTTON_GESTURE_DOUBLE_CLICK] == expectedDoubleClicks && others == 0 &&
+					 lastGestureDelay <= maxDelayMs;
+	printf("%s: %lu clicks, %lu double clicks, %lu others, last one %lu ms after the release%s\n", name,
+		   (unsigned long)gestureCounts[BUTTON_GESTURE_CLICK], (unsigned long)gestureCounts[BUTTON_GESTURE_DOUBLE_CLICK],
+		   (unsigned long)others, (unsigned long)lastGestureDelay, passed ? "" : " FAILED");
+	return passed;
+}
+
+int main(void)
+{
+	InitButtonWithDefaults(&hostPort, DOUBLE_CLICK_PIN, GPIO_PIN_SET);
+	InitButtonWithDefaults(&hostPort, CLICK_PIN, GPIO_PIN_SET);
+	Hold(0, SETTLE_MS, 1); //Settles the buttons sampled since boot
+
+	uint32_t failures = 0;
+	//A click is only reported once the double click time passed without a second press.
+	uint32_t clickDelay = BUTTON_GESTURE_DOUBLE_CLICK_MS + MAX_EVENT_LATENCY_MS;
+	uint32_t doubleClickDelay = MAX_EVENT_LATENCY_MS;
+	failures += !RunCase("click", DOUBLE_CLICK_PIN, 1, 0, 1, 1, 0, clickDelay);
+	failures += !RunCase("double click", DOUBLE_CLICK_PIN, 2, GAP_MS, 1, 0, 1, doubleClickDelay);
+	failures += !RunCase("two slow clicks", DOUBLE_CLICK_PIN, 2, BUTTON_GESTURE_DOUBLE_CLICK_MS + 100, 1, 2, 0,
+						 clickDelay);
+	//The main loop was busy until long after the double click time, the gestures come on its first pass. The events
+	//still tell when they happened.
+	uint32_t lateDelay = SETTLE_MS + MAX_EVENT_LATENCY_MS;
+	failures += !RunCase("late click", DOUBLE_CLICK_PIN, 1, 0, 0, 1, 0, lateDelay);
+	failures += !RunCase("late double click", DOUBLE_CLICK_PIN, 2, GAP_MS, 0, 0, 1, GAP_MS + lateDelay);
+	//Without double clicks nothing is waited for after the release.
+	failures += !RunCase("click without double clicks", CLICK_PIN, 1, 0, 1, 1, 0, MAX_EVENT_LATENCY_MS);
+	failures += !RunCase("two quick clicks without double clicks", CLICK_PIN, 2, GAP_MS, 1, 2, 0,
+						 MAX_EVENT_LATENCY_MS);
+	return failures != 0;
+}
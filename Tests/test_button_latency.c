@@ -0,0 +1,131 @@
+/*
+ * test_button_latency.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+//Measures the time from a button edge to its event in the queue, with the pin sampled from the simulated SysTick
+//interrupt like on the board. The contacts bounce for a while after every edge.
+
+#include "stm32f1xx_hal.h"
+#include "debounced_button.h"
+#include <stdio.h>
+
+#define BUTTON_PIN			(1 << 3)
+#define MAX_BOUNCE_MS		10
+#define HOLD_MS				100
+//The pin has to read the new state for BUTTON_BANK_STABLE_SAMPLES samples in a row, the first of which can come up
+//to a sample period after the bouncing ended.
+#define MAX_LATENCY_MS		(BUTTON_BANK_STABLE_SAMPLES * BUTTON_BANK_SAMPLE_PERIOD_MS)
+
+static GPIO_TypeDef hostPort;
+static uint32_t tick = 0;
+
+//One millisecond: the pin reads level, the EXTI interrupt runs on a change, then SysTick does.
+static void RunTick(uint8_t level)
+{
+	HostTick_Set(++tick);
+	uint32_t idr = level ? BUTTON_PIN : 0;
+	if (idr != hostPort.IDR)
+	{
+		hostPort.IDR = idr;
+		SignalButtonEdgeFromISR(BUTTON_PIN);
+	}
+	SampleDebouncedButtonsFromISR();
+}
+
+/*
+  Moves the pin to level, bouncing for bounceMs first. Returns the latency of the event from the end of the
+  bouncing, or -1 if there wasn't exactly one event of the right type.
+*/
+static int32_t Switch(uint8_t level, uint8_t bounceMs)
+{
+	uint32_t edgeTick = tick + 1;
+	for (uint8_t i = 0; i < bounceMs; i++)
+	{
+		RunTick((i % 2) == 0 ? level : !level);
+	}
+	uint32_t stableTick = tick + 1;
+	for (uint32_t i = 0; i < HOLD_MS; i++)
+	{
+		RunTick(level);
+	}
+
+	ButtonEvent event;
+	uint8_t events = 0;
+	int32_t latency = -1;
+	while (PopButtonEvent(&event))
+	{
+		events++;
+		ButtonEventType expected = level ? BUTTON_EVENT_PRESSED : BUTTON_EVENT_RELEASED;
+		if (event.gpioPin == BUTTON_PIN && event.type == expected && event.tick >= edgeTick)
+		{
+			latency = (int32_t)(event.tick - stableTick);
+		}
+	}
+	return events == 1 ? latency : -1;
+}
+
+int main(void)
+{
+	InitButtonWithDefaults(&hostPort, BUTTON_PIN, GPIO_PIN_SET);
+	for (uint32_t i = 0; i < HOLD_MS; i++)
+	{
+		RunTick(0); //Settles the buttons sampled since boot
+	}
+
+	uint32_t failures = 0;
+	int32_t worstLatency = 0;
+	//Every bounce length at every phase of the sampling.
+	for (uint8_t bounceMs = 0; bounceMs <= MAX_BOUNCE_MS; bounceMs++)
+	{
+		for (uint8_t phase = 0; phase < BUTTON_BANK_SAMPLE_PERIOD_MS; phase++)
+		{
+			for (uint8_t i = 0; i < phase; i++)
+			{
+				RunTick(0);
+			}
+			int32_t pressLatency = Switch(1, bounceMs);
+			int32_t releaseLatency = Switch(0, bounceMs);
+			if (pressLatency < 0 || releaseLatency < 0 || pressLatency > MAX_LATENCY_MS ||
+				releaseLatency > MAX_LATENCY_MS)
+			{
+				printf("bounce %u ms, phase %u: press latency %ld, release latency %ld FAILED\n", bounceMs, phase,
+					   (long)pressLatency, (long)releaseLatency);
+				failures++;
+			}
+			worstLatency = pressLatency > worstLatency ? pressLatency : worstLatency;
+			worstLatency = releaseLatency > worstLatency ? releaseLatency : worstLatency;
+		}
+	}
+	printf("Worst latency after the bouncing: %ld ms (at most %d ms)\n", (long)worstLatency, MAX_LATENCY_MS);
+
+	//Presses while the main loop is busy, like during the 3 second I2C error message, are queued and kept.
+	uint32_t pressesBefore = GetButtonPressCount();
+	for (uint8_t i = 0; i < BUTTON_EVENT_QUEUE_LENGTH / 2; i++)
+	{
+		for (uint32_t t = 0; t < HOLD_MS; t++)
+		{
+			RunTick(1);
+		}
+		for (uint32_t t = 0; t < HOLD_MS; t++)
+		{
+			RunTick(0);
+		}
+	}
+	ButtonEvent event;
+	uint8_t queued = 0;
+	while (PopButtonEvent(&event))
+	{
+		queued++;
+	}
+	uint32_t presses = GetButtonPressCount() - pressesBefore;
+	printf("%u of %u events kept while busy, %lu presses counted\n", queued, BUTTON_EVENT_QUEUE_LENGTH,
+		   (unsigned long)presses);
+	if (queued != BUTTON_EVENT_QUEUE_LENGTH || presses != BUTTON_EVENT_QUEUE_LENGTH / 2 ||
+		GetButtonEventStats()->droppedEvents != 0)
+	{
+		failures++;
+	}
+	return failures != 0;
+}
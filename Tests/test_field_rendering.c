@@ -0,0 +1,137 @@
+/*
+ * test_field_rendering.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+//Runs the time page through a simulated day and records how many characters every render formats. Only the fields
+//that changed should be rendered, and the screen has to show the right time after every second.
+
+#include "lcd_stub.h"
+#include <stdio.h>
+#include <string.h>
+
+//The rendered frames are private to the display, so they are checked from inside.
+#include "../Core/Src/display_control.c"
+
+#define SIMULATED_SECONDS	(24 * 60 * 60)
+#define MISSING_SQW_EVERY	7 //Every 7th SQW edge is dropped, those seconds are rendered without the pre-render
+#define HISTOGRAM_LENGTH	(LCD_STUB_LINES * 16 + 1)
+
+//Characters the changed fields of the time page take in 24h format. Hours include the blank suffix.
+static uint32_t GetExpectedCharacters(uint8_t changedFields)
+{
+	uint32_t characters = 0;
+	characters += (changedFields & DISPLAY_FIELD_SECONDS) ? 2 : 0;
+	characters += (changedFields & DISPLAY_FIELD_MINUTES) ? 2 : 0;
+	characters += (changedFields & DISPLAY_FIELD_HOURS) ? 4 : 0;
+	characters += (changedFields & DISPLAY_FIELD_DATE) ? 11 : 0;
+	characters += (changedFields & DISPLAY_FIELD_WEEKDAY) ? 3 : 0;
+	return characters;
+}
+
+//Returns 1 if the visible half of the DDRAM shows info the way the time page should.
+static uint8_t IsShownCorrectly(const DisplayInfo* info)
+{
+	static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+	static const char* days[] = { "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun" };
+	char expected[LCD_STUB_LINES][24];
+	snprintf(expected[0], sizeof(expected[0]), "%02u:%02u:%02u       >", info->hours, info->minutes, info->seconds);
+	snprintf(expected[1], sizeof(expected[1]), "%02u %s %04u  %s", info->dayOfTheMonth, months[info->month - 1],
+			 info->year, days[info->dayOfTheWeek - 1]);
+	for (uint8_t line = 0; line < LCD_STUB_LINES; line++)
+	{
+		if (memcmp(&hostDDRAM[line][hostDDRAMBank * 16], expected[line], 16) != 0)
+		{
+			printf("line %u shows \"%.16s\", expected \"%s\"\n", line + 1, &hostDDRAM[line][hostDDRAMBank * 16],
+				   expected[line]);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(void)
+{
+	DisplayInfo info = { 0 };
+	info.dayOfTheMonth = 19;
+	info.month = 10;
+	info.year = 2026;
+	info.dayOfTheWeek = 1;
+	info.alarmHours = 7;
+	info.alarmMinutes = 30;
+	info.alarmEnabled = ALARM_ENABLED;
+	info.temperature = (23 << 8) | (1 << 6);
+
+	uint32_t histogram[HISTOGRAM_LENGTH] = { 0 };
+	uint32_t renders = 0, totalCharacters = 0, dateRenders = 0, failures = 0;
+	for (uint32_t second = 0; second <= SIMULATED_SECONDS; second++)
+	{
+		HostTick_Set(second * 1000);
+		info.seconds = second % 60;
+		info.minutes = second / 60 % 60;
+		info.hours = second / 3600 % 24;
+		if (second == SIMULATED_SECONDS)
+		{
+			info.dayOfTheMonth++;
+			info.dayOfTheWeek++;
+		}
+		//The temperature changes every 10 minutes, it isn't on the time page.
+		if (second % 600 == 0)
+		{
+			info.temperature = ((23 + second / 600 % 3) << 8) | ((second / 600 % 4) << 6);
+		}
+		if (second % MISSING_SQW_EVERY != 3)
+		{
+			SignalSecondBoundary();
+		}
+
+		//The pass at the boundary, and one in the middle of the second that pre-renders the next one.
+		for (uint8_t pass = 0; pass < 2; pass++)
+		{
+			DisplayInfo previousFrame = frameInfo;
+			uint8_t hadFrame = frameIsValid;
+			HostTick_Set(second * 1000 + pass * 500);
+			DisplayTime(&info);
+			if (!hadFrame || memcmp(&previousFrame, &frameInfo, sizeof(DisplayInfo)) == 0)
+			{
+				continue;
+			}
+
+			uint8_t changedFields = GetChangedDisplayFields(&previousFrame, &frameInfo);
+			uint32_t characters = GetDisplayRenderStats()->lastRenderedCharacters;
+			if (characters != GetExpectedCharacters(changedFields))
+			{
+				printf("second %lu: %lu characters rendered for fields 0x%02X, expected %lu\n", (unsigned long)second,
+					   (unsigned long)characters, changedFields, (unsigned long)GetExpectedCharacters(changedFields));
+				failures++;
+			}
+			renders++;
+			totalCharacters += characters;
+			histogram[characters < HISTOGRAM_LENGTH ? characters : HISTOGRAM_LENGTH - 1]++;
+			dateRenders += (changedFields & DISPLAY_FIELD_DATE) != 0;
+		}
+		if (!IsShownCorrectly(&info))
+		{
+			printf("second %lu is shown wrong\n", (unsigned long)second);
+			failures++;
+		}
+	}
+
+	printf("%lu renders, %lu characters (%lu.%02lu per render), date rendered %lu times, %lu written to the LCD\n",
+		   (unsigned long)renders, (unsigned long)totalCharacters, (unsigned long)(totalCharacters / renders),
+		   (unsigned long)(totalCharacters * 100 / renders % 100), (unsigned long)dateRenders,
+		   (unsigned long)hostCharactersWritten);
+	for (uint8_t i = 0; i < HISTOGRAM_LENGTH; i++)
+	{
+		if (histogram[i] != 0)
+		{
+			printf("  %2u characters: %lu renders\n", i, (unsigned long)histogram[i]);
+		}
+	}
+	if (dateRenders != 1)
+	{
+		failures++;
+	}
+	return failures != 0;
+}
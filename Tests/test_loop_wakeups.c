@@ -0,0 +1,138 @@
+/*
+ * test_loop_wakeups.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+//Counts how often the main loop runs for the display outside edit mode, when it sleeps for GetDisplayIdleMs() or
+//until the SQW edge like the firmware does. Checks that every second is still displayed on its boundary.
+
+#include "lcd_stub.h"
+#include <stdio.h>
+#include <string.h>
+
+//The displayed info is private to the display, so it is checked from inside.
+#include "../Core/Src/display_control.c"
+
+#define SIMULATED_SECONDS	120
+#define SQW_PHASE_MS		370 //Where the second boundaries fall relative to the tick count
+//The pass at the boundary flips, reads and pre-renders the next second. Some room for the refreshes.
+#define MAX_PASSES_PER_SECOND	2
+
+static void AdvanceClock(DisplayInfo* clock)
+{
+	if (++clock->seconds < 60)
+	{
+		return;
+	}
+	clock->seconds = 0;
+	if (++clock->minutes < 60)
+	{
+		return;
+	}
+	clock->minutes = 0;
+	clock->hours = (clock->hours + 1) % 24;
+}
+
+/*
+  Runs the display part of the main loop on page for SIMULATED_SECONDS, with or without the SQW signal. Returns the
+  number of passes, lateSeconds is set to the number of seconds that weren't displayed by the next millisecond and
+  lateFlips to the number of pre-rendered seconds that weren't flipped in before the DS3231 was read.
+*/
+static uint32_t SimulatePage(uint8_t page, uint8_t withSQW, uint32_t* lateSeconds, uint32_t* lateFlips)
+{
+	static uint32_t startTick = 0;
+	DisplayInfo clock = { 0 };
+	clock.hours = 23;
+	clock.minutes = 58;
+	clock.dayOfTheMonth = 19;
+	clock.month = 10;
+	clock.year = 2026;
+	clock.dayOfTheWeek = 1;
+	DisplayInfo info = clock;
+
+	//Each simulation continues from where the last one stopped, the display keeps its ticks.
+	HostTick_Set(startTick);
+	DisplayTime(&info);
+	SwitchToPage(page);
+
+	uint32_t passes = 0;
+	uint32_t sleepStartTick = startTick;
+	uint32_t idleMs = 0;
+	uint8_t secondBoundarySeen = 0;
+	*lateSeconds = 0;
+	*lateFlips = 0;
+	for (uint32_t t = startTick; t < startTick + SIMULATED_SECONDS * 1000; t++)
+	{
+		HostTick_Set(t);
+		uint8_t isBoundary = (t % 1000) == SQW_PHASE_MS;
+		if (isBoundary)
+		{
+			AdvanceClock(&clock);
+			if (withSQW)
+			{
+				SignalSecondBoundary();
+				secondBoundarySeen = 1;
+			}
+		}
+
+		if (secondBoundarySeen || (t - sleepStartTick) >= idleMs)
+		{
+			//The date changes at midnight aren't pre-rendered, those seconds are rendered after the read.
+			uint8_t hadFrame = hasPreRenderedFrame;
+			uint8_t flipped = FlipToNextSecond(&info);
+			if (ShouldReadDisplayInfo())
+			{
+				if (isBoundary && withSQW && hadFrame && !flipped)
+				{
+					(*lateFlips)++;
+				}
+				info = clock;
+			}
+			DisplayTime(&info);
+			passes++;
+			secondBoundarySeen = 0;
+			sleepStartTick = t;
+			idleMs = GetDisplayIdleMs();
+		}
+
+		//Only the SQW edge tells the boundary right away, without it the seconds are polled.
+		if (withSQW && (t % 1000) == SQW_PHASE_MS + 1 && lastDisplayedInfo.seconds != clock.seconds)
+		{
+			(*lateSeconds)++;
+		}
+	}
+	startTick += SIMULATED_SECONDS * 1000;
+	return passes;
+}
+
+int main(void)
+{
+	uint32_t failures = 0;
+	//Without the SQW signal the seconds are polled on every tick, those passes are only reported.
+	static const uint8_t sqwModes[] = { 1, 0 };
+	for (uint8_t i = 0; i < arr_size(sqwModes); i++)
+	{
+		uint8_t withSQW = sqwModes[i];
+		for (uint8_t page = 1; page <= DISPLAY_PAGE_COUNT; page++)
+		{
+			uint32_t lateSeconds = 0, lateFlips = 0;
+			uint32_t passes = SimulatePage(page, withSQW, &lateSeconds, &lateFlips);
+			uint32_t refreshPeriod = pages[page - 1].refreshPeriodMs;
+			//Pages that refresh faster than once a second need a pass per refresh on top of the boundaries.
+			uint32_t maxPasses = SIMULATED_SECONDS * MAX_PASSES_PER_SECOND;
+			if (refreshPeriod < 1000)
+			{
+				maxPasses += SIMULATED_SECONDS * 1000 / refreshPeriod;
+			}
+			uint8_t failed = withSQW && (passes > maxPasses || lateSeconds != 0 || lateFlips != 0);
+			printf("page %u, %s SQW: %lu passes in %u s (%lu.%02lu per second), %lu late seconds, %lu flips after "
+				   "the read%s\n", page,
+				   withSQW ? "with" : "without", (unsigned long)passes, SIMULATED_SECONDS,
+				   (unsigned long)(passes / SIMULATED_SECONDS), (unsigned long)(passes * 100 / SIMULATED_SECONDS % 100),
+				   (unsigned long)lateSeconds, (unsigned long)lateFlips, failed ? " FAILED" : "");
+			failures += failed;
+		}
+	}
+	return failures != 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * test_temperature.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+//Checks the fixed-point temperature conversion against a floating point reference, for every raw value the
+//DS3231 can report in every unit.
+
+#include "lcd_stub.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+//The conversion is private to the display, so it is tested from inside.
+#include "../Core/Src/display_control.c"
+
+int main(void)
+{
+	static const uint8_t units[] = { TEMP_UNIT_CELSIUS, TEMP_UNIT_FAHRENHEIT, TEMP_UNIT_KELVIN };
+	uint32_t failures = 0;
+	for (uint16_t raw = 0; raw < 1024; raw++)
+	{
+		//10 bit two's complement quarter degrees, left aligned in the two temperature registers.
+		uint16_t registers = raw << 6;
+		double celsius = (raw >= 512 ? (int)raw - 1024 : (int)raw) / 4.0;
+		for (uint8_t i = 0; i < arr_size(units); i++)
+		{
+			double reference = units[i] == TEMP_UNIT_FAHRENHEIT ? celsius * 9.0 / 5.0 + 32.0 :
+							   units[i] == TEMP_UNIT_KELVIN ? celsius + 273.15 : celsius;
+			int32_t expected = (int32_t)lround(reference * 100.0);
+			int32_t converted = ConvertTemperatureToCenti(registers, units[i]);
+
+			//What the display shows has to match as well.
+			char formatted[16];
+			*Format_Centi(formatted, converted) = '\0';
+			char expectedText[16];
+			snprintf(expectedText, sizeof(expectedText), "%+06.2f", reference);
+			if (converted != expected || strcmp(formatted, expectedText) != 0)
+			{
+				printf("raw 0x%03X %s: got %ld \"%s\", expected %ld \"%s\"\n", raw, GetTemperatureUnit(units[i])->name,
+					   (long)converted, formatted, (long)expected, expectedText);
+				failures++;
+			}
+		}
+	}
+	printf("%lu of %u conversions wrong\n", (unsigned long)failures, 1024u * (unsigned)arr_size(units));
+	return failures != 0;
+}